@@ -0,0 +1,123 @@
+#include <algorithm>
+
+#include "LogGPModel.h"
+
+
+LogGPModel::LogGPModel(const Params &params, const double secsPerDart) :
+    params_(params),
+    secsPerDart_(secsPerDart)
+{
+}
+
+
+LogGPModel::~LogGPModel()
+{
+}
+
+
+LogGPModel::Prediction
+LogGPModel::predict(const int numTasks, const uint64_t totalDarts,
+    const std::size_t settingsBytes, const ReduceAlgo algo,
+    const double pollSecs) const
+{
+    Prediction ret;
+    const uint64_t numTasks64{ uint64_t(std::max(numTasks, 1)) };
+    // Slowest task is the one picking up the remainder.
+    const uint64_t maxDarts{ (totalDarts + numTasks64 - 1) / numTasks64 };
+
+    ret.bcast_ = bcastTime(numTasks, settingsBytes);
+    ret.compute_ = secsPerDart_ * double(maxDarts);
+    // MpiProcess::run() always syncs starts. The barrier after the throws
+    // is where the early tasks wait for the slowest one.
+    ret.barrier_ = 2.0 * barrierTime(numTasks);
+    if (numTasks > 1) {
+        ret.barrier_ += ceilLog2(numTasks) * pollSecs;
+    }
+    ret.reduce_ = reduceTime(numTasks, sizeof(uint64_t), algo);
+    ret.total_ = ret.bcast_ + ret.compute_ + ret.barrier_ + ret.reduce_;
+
+    const double serial{ secsPerDart_ * double(totalDarts) };
+    if (ret.total_ > 0.0) {
+        ret.efficiency_ = serial / (double(numTasks64) * ret.total_);
+    }
+    return ret;
+}
+
+
+double
+LogGPModel::p2pTime(const std::size_t bytes) const
+{
+    // send overhead + wire + receive overhead
+    return params_.L_ + (2.0 * params_.o_) +
+        (double((bytes > 0) ? (bytes - 1) : 0) * params_.G_);
+}
+
+
+double
+LogGPModel::bcastTime(const int numTasks, const std::size_t bytes) const
+{
+    // binomial tree: every round doubles the number of tasks holding data
+    return ceilLog2(numTasks) * p2pTime(bytes);
+}
+
+
+double
+LogGPModel::barrierTime(const int numTasks) const
+{
+    // dissemination barrier: log2(P) rounds of zero byte messages
+    return ceilLog2(numTasks) * p2pTime(0);
+}
+
+
+double
+LogGPModel::reduceTime(const int numTasks, const std::size_t bytes,
+    const ReduceAlgo algo) const
+{
+    double ret = 0.0;
+    if (numTasks < 2) {
+        // nothing to combine
+    }
+    else if (ReduceRecDoubling == algo) {
+        // log2 of the largest power of two, plus a round on each side to
+        // fold in and hand back the leftover tasks
+        const int rounds = ceilLog2(numTasks + 1) - 1;
+        const bool folded = ((1 << rounds) != numTasks);
+        ret = (rounds + (folded ? 2 : 0)) * p2pTime(bytes);
+    }
+    else if (ReduceRing == algo) {
+        // P-1 block exchanges around the ring, then root gathers P-1 blocks
+        const std::size_t blockBytes{ (bytes + numTasks - 1) / numTasks };
+        const double perMsg{ std::max(params_.g_,
+            params_.o_ + (double(blockBytes) * params_.G_)) };
+        ret = (double(numTasks - 1) * p2pTime(blockBytes)) +
+            p2pTime(blockBytes) + (double(numTasks - 2) * perMsg);
+    }
+    else {
+        ret = ceilLog2(numTasks) * p2pTime(bytes);
+    }
+    return ret;
+}
+
+
+const char *
+LogGPModel::toString(const ReduceAlgo algo)
+{
+    switch (algo) {
+    case ReduceBinomial:    return "binomial";
+    case ReduceRecDoubling: return "recdbl";
+    case ReduceRing:        return "ring";
+    default:                break;
+    }
+    return "unknown";
+}
+
+
+int
+LogGPModel::ceilLog2(const int n)
+{
+    int ret = 0;
+    while ((1 << ret) < n) {
+        ++ret;
+    }
+    return ret;
+}
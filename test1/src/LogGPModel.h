@@ -0,0 +1,84 @@
+#ifndef LOGGPMODEL_H
+#define LOGGPMODEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+
+//****************************************************************************
+//****************************************************************************
+//****************************************************************************
+
+// Analytic LogGP cost model of the MpiCalcPi phase sequence:
+//
+//   barrier (sync start) -> bcast Settings -> throw darts ->
+//   barrier -> reduce hits
+//
+// All times are in seconds. Params are measured on a small run (see
+// MpiProcess::mpiMeasureLogGP()) and replayed here to predict runtime and
+// parallel efficiency at rank counts we cannot afford to try blind.
+class LogGPModel {
+public:
+    struct Params {
+        double  L_{ 0.0 };  // end-to-end latency of a small message
+        double  o_{ 0.0 };  // CPU overhead to send or receive one message
+        double  g_{ 0.0 };  // min gap between consecutive small messages
+        double  G_{ 0.0 };  // gap per byte of a long message
+    };
+
+    // Message patterns of the MpiProcess::CollAlgo reductions
+    enum ReduceAlgo {
+        ReduceBinomial,     // log2(P) rounds of point-to-point messages
+        ReduceRecDoubling,  // butterfly plus fold/unfold of the leftovers
+        ReduceRing,         // ring reduce-scatter, then gather at root
+        NumReduceAlgos
+    };
+
+    struct Prediction {
+        double  bcast_{ 0.0 };
+        double  compute_{ 0.0 };
+        double  barrier_{ 0.0 };
+        double  reduce_{ 0.0 };
+        double  total_{ 0.0 };
+        double  efficiency_{ 0.0 }; // serial time / (numTasks * total_)
+    };
+
+public:
+    LogGPModel(const Params &params, const double secsPerDart);
+
+    ~LogGPModel();
+
+
+    // pollSecs is how late a task that waited out the load imbalance
+    // notices each message of the barrier after the throws, as measured by
+    // MpiProcess::mpiMeasureWakeSecs(). 0 for blocking waits.
+    Prediction      predict(const int numTasks, const uint64_t totalDarts,
+                        const std::size_t settingsBytes, const ReduceAlgo algo,
+                        const double pollSecs) const;
+
+    double          p2pTime(const std::size_t bytes) const;
+
+    double          bcastTime(const int numTasks,
+                        const std::size_t bytes) const;
+
+    double          barrierTime(const int numTasks) const;
+
+    double          reduceTime(const int numTasks, const std::size_t bytes,
+                        const ReduceAlgo algo) const;
+
+    const Params &  params() const {
+                        return params_; }
+
+    double          secsPerDart() const {
+                        return secsPerDart_; }
+
+    static const char * toString(const ReduceAlgo algo);
+
+    static int      ceilLog2(const int n);
+
+private:
+    Params  params_;
+    double  secsPerDart_{ 0.0 };
+};
+
+#endif // LOGGPMODEL_H
@@ -0,0 +1,138 @@
+#include <fstream>
+
+#ifdef _WIN32
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+
+MappedFile::MappedFile()
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+bool
+MappedFile::open(const std::string &path, const uint64_t offset,
+    const uint64_t length)
+{
+    close();
+    if (0 == length) {
+        return true; // nothing to map
+    }
+
+    // Views must start on an alignment boundary. Map from the boundary
+    // below offset and skip the slack.
+    const uint64_t start{ offset - (offset % mapAlignment()) };
+    viewBytes_ = length + (offset - start);
+    bool ret = true;
+#ifdef _WIN32
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == file_) {
+        file_ = nullptr;
+        ret = false;
+    }
+    else if (nullptr == (mapping_ = CreateFileMappingA(file_, nullptr,
+            PAGE_READONLY, 0, 0, nullptr))) {
+        ret = false;
+    }
+    else if (nullptr == (view_ = MapViewOfFile(mapping_, FILE_MAP_READ,
+            DWORD(start >> 32), DWORD(start & 0xffffffff),
+            SIZE_T(viewBytes_)))) {
+        ret = false;
+    }
+#else
+    if (-1 == (fd_ = ::open(path.c_str(), O_RDONLY))) {
+        ret = false;
+    }
+    else {
+        // readahead hint for the page cache, then map the range
+        posix_fadvise(fd_, off_t(start), off_t(viewBytes_),
+            POSIX_FADV_SEQUENTIAL);
+        view_ = mmap(nullptr, viewBytes_, PROT_READ, MAP_SHARED, fd_,
+            off_t(start));
+        if (MAP_FAILED == view_) {
+            view_ = nullptr;
+            ret = false;
+        }
+        else {
+            madvise(view_, viewBytes_, MADV_SEQUENTIAL);
+        }
+    }
+#endif
+
+    if (ret) {
+        data_ = static_cast<const char*>(view_) + (offset - start);
+        size_ = length;
+    }
+    else {
+        close();
+    }
+    return ret;
+}
+
+
+void
+MappedFile::close()
+{
+#ifdef _WIN32
+    if (nullptr != view_) {
+        UnmapViewOfFile(view_);
+    }
+    if (nullptr != mapping_) {
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+    }
+    if (nullptr != file_) {
+        CloseHandle(file_);
+        file_ = nullptr;
+    }
+#else
+    if (nullptr != view_) {
+        munmap(view_, viewBytes_);
+    }
+    if (-1 != fd_) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+#endif
+    view_ = nullptr;
+    viewBytes_ = 0;
+    data_ = nullptr;
+    size_ = 0;
+}
+
+
+bool
+MappedFile::fileSize(const std::string &path, uint64_t &size)
+{
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    const bool ret = f.good();
+    size = (ret ? uint64_t(f.tellg()) : 0);
+    return ret;
+}
+
+
+uint64_t
+MappedFile::mapAlignment()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return uint64_t(sysconf(_SC_PAGESIZE));
+#endif
+}
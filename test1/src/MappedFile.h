@@ -0,0 +1,56 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstdint>
+#include <string>
+
+
+//****************************************************************************
+//****************************************************************************
+//****************************************************************************
+
+// Read-only memory map of one byte range of a file. Only the pages holding
+// the range are mapped and the OS is told they will be read sequentially.
+class MappedFile {
+public:
+    MappedFile();
+
+    ~MappedFile();
+
+
+    // Maps bytes [offset, offset + length) of path. offset does not need to
+    // be page aligned. A zero length range succeeds with a null data().
+    bool            open(const std::string &path, const uint64_t offset,
+                        const uint64_t length);
+
+    void            close();
+
+    const char *    data() const {
+                        return data_; }
+
+    uint64_t        size() const {
+                        return size_; }
+
+    static bool     fileSize(const std::string &path, uint64_t &size);
+
+private:
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &    operator=(const MappedFile &) = delete;
+
+    static uint64_t mapAlignment();
+
+private:
+    void *          view_{ nullptr };
+    uint64_t        viewBytes_{ 0 };
+    const char *    data_{ nullptr };
+    uint64_t        size_{ 0 };
+#ifdef _WIN32
+    void *          file_{ nullptr };       // HANDLE
+    void *          mapping_{ nullptr };    // HANDLE
+#else
+    int             fd_{ -1 };
+#endif
+};
+
+#endif // MAPPEDFILE_H
@@ -1,21 +1,122 @@
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <functional>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <random>
+#include <vector>
 
+#include "MappedFile.h"
 #include "MpiCalcPi.h"
 
 
 struct Settings {
     MpiCalcPi::Hits totalNumThrows_{ int(5e6) }; // TOTAL throws at dartboard
+    int             predictMaxTasks_{ 0 }; // >0 predicts scaling, no throws
+    MpiProcess::CollAlgo collAlgo_{ MpiProcess::CollLibrary };
+    MpiProcess::WaitStrategy waitStrategy_{ MpiProcess::WaitDefault };
+    bool            controlVariate_{ false }; // also count octagon hits
+    int             vegasIters_{ 0 }; // >0 integrates with VEGAS, no darts
+    char            dartsFile_[1024]{ '\0' }; // read darts, don't generate
+    int             histBins_{ 0 }; // >0 checks radius/angle uniformity
+    int             argsRet_{ MpiProcess::ErrNone }; // manager's processArgs()
 };
 
 
+// Regular octagon inscribed in the unit circle with vertices at 22.5 deg +
+// k*45 deg. Its edges sit at distance cos(22.5 deg) from the origin along the
+// axes and the diagonals. Area is 2*sqrt(2), or sqrt(2)/2 of the dartboard.
+static constexpr double OctApothem{ 0.92387953251128674 };
+static constexpr double OctDiagApothem{ 1.30656296487637653 }; // * sqrt(2)
+static constexpr double OctAreaFraction{ 0.70710678118654752 };
 
-MpiCalcPi::MpiCalcPi() :
-    MpiProcess()
+// A darts file is a flat array of native doubles, x then y, in [-1.0, 1.0].
+static constexpr uint64_t DartBytes{ 2 * sizeof(double) };
+
+
+// Scores numDarts darts, pulling their coords from nextCoord() in x, y
+// order. Counts octagon hits too if octHits is given. onHit(x, y) sees
+// every dart that lands in the circle.
+template<typename NextCoord, typename OnHit>
+static MpiCalcPi::Hits
+scoreDarts(const MpiCalcPi::Hits numDarts, NextCoord nextCoord,
+    MpiCalcPi::Hits *octHits, OnHit onHit)
+{
+    MpiCalcPi::Hits hits = 0;
+    if (nullptr == octHits) {
+        for (MpiCalcPi::Hits n = 0; n < numDarts; ++n) {
+            const double x{ nextCoord() };
+            const double y{ nextCoord() };
+            // Is (x^2 + y^2) <= 1.0^2 ?
+            if (((x * x) + (y * y)) <= 1.0) {
+                // dart landed in circle! Increment hits.
+                ++hits;
+                onHit(x, y);
+            }
+        }
+    }
+    else {
+        // same darts, also scored against the inscribed octagon
+        MpiCalcPi::Hits oct = 0;
+        for (MpiCalcPi::Hits n = 0; n < numDarts; ++n) {
+            const double x{ nextCoord() };
+            const double y{ nextCoord() };
+            if (((x * x) + (y * y)) <= 1.0) {
+                ++hits;
+                onHit(x, y);
+            }
+            const double ax{ std::fabs(x) };
+            const double ay{ std::fabs(y) };
+            if ((ax <= OctApothem) && (ay <= OctApothem) &&
+                    ((ax + ay) <= OctDiagApothem)) {
+                ++oct;
+            }
+        }
+        *octHits = oct;
+    }
+    return hits;
+}
+
+
+// scoreDarts() that also bins the hits into hist, if not empty. The
+// radius and angle bins are stored task by task, numTasks slices of each.
+template<typename NextCoord>
+static MpiCalcPi::Hits
+scoreHits(const MpiCalcPi::Hits numDarts, NextCoord nextCoord,
+    MpiCalcPi::Hits *octHits, std::vector<MpiCalcPi::Hits> *hist,
+    const int numTasks)
+{
+    if ((nullptr == hist) || hist->empty()) {
+        return scoreDarts(numDarts, nextCoord, octHits,
+            [](const double, const double) {});
+    }
+
+    // For uniform darts, r^2 and the angle are both uniform.
+    const std::size_t numBins{ hist->size() / 2 };
+    const std::size_t binsPerTask{ numBins / numTasks };
+    const double twoPi{ 2.0 * 3.1415926535897932 };
+    MpiCalcPi::Hits *bins = hist->data();
+    auto binHit = [bins, numBins, binsPerTask, twoPi](const double x,
+            const double y) {
+        const double r2{ (x * x) + (y * y) };
+        const double angle{ std::atan2(y, x) + (0.5 * twoPi) };
+        const std::size_t rb{ std::min(std::size_t(r2 * numBins),
+            numBins - 1) };
+        const std::size_t ab{ std::min(std::size_t((angle / twoPi) *
+            numBins), numBins - 1) };
+        // task t owns [radius bins, angle bins] at 2 * t * binsPerTask
+        ++bins[(2 * (rb - (rb % binsPerTask))) + (rb % binsPerTask)];
+        ++bins[(2 * (ab - (ab % binsPerTask))) + binsPerTask +
+            (ab % binsPerTask)];
+    };
+    return scoreDarts(numDarts, nextCoord, octHits, binHit);
+}
+
+
+MpiCalcPi::MpiCalcPi(const MPI_Comm comm, const int managerTaskId) :
+    MpiProcess(comm, managerTaskId)
 {
 }
 
@@ -25,49 +126,118 @@ MpiCalcPi::~MpiCalcPi()
 }
 
 
+MpiCalcPi::Results
+MpiCalcPi::calcPi(const StringArray1 &args)
+{
+    results_ = Results();
+    results_.ret_ = runEmbedded(args);
+    return results_;
+}
+
+
 int
 MpiCalcPi::runAsManagerImpl(const StringArray1 &args)
 {
     std::cout << getVersionString() << std::endl;
+    std::cout << "Resources: " << resourceLimits().toString() << ", " <<
+        numNodeTasks() << " tasks on node" <<
+        (oversubscribed() ? " (oversubscribed)" : "") << std::endl;
 
+    // Settings go out even if the args are bad so the workers don't wait
+    // for them forever.
     Settings s;
-    int ret = processArgs(args, s);
-    if (!MPIOK(ret)) {
-        // ret already set
-    }
-    else if (!MPIOK(MPI_Bcast(&s, sizeof(s), MPI_UNSIGNED_CHAR, managerTaskId(), comm()))) {
+    s.argsRet_ = processArgs(args, s);
+    int ret = ErrNone;
+    if (!mpiBcast(&s, sizeof(s), MPI_UNSIGNED_CHAR, RootUseManager,
+            CollLibrary)) {
         ret = ErrBcast;
     }
+    else if (ErrNone != s.argsRet_) {
+        ret = s.argsRet_;
+    }
+    else if (!applySettings(s)) {
+        ret = ErrTune;
+    }
+    else if (0 < s.predictMaxTasks_) {
+        ret = predictScaling(s);
+    }
+    else if (0 < s.vegasIters_) {
+        ret = integrateVegas(s);
+    }
     else {
-        // Manager task also picks up any throws lost to integer truncation.
-        const Hits numThrows = (s.totalNumThrows_ / numTasks()) +
-            (s.totalNumThrows_ % (s.totalNumThrows_ / numTasks()));
-
         // compute pi for this task
-        const Hits hits = throwDarts(numThrows);
+        const double t0 = MPI_Wtime();
+        Hits numThrows = 0;
+        Hits sumThrows = 0;
+        Hits hits[2]{ 0, 0 }; // circle hits, octagon hits
+        std::vector<Hits> hist;
+        ret = throwTaskDarts(s, numThrows, sumThrows, hits, hist);
 
-        std::cout << "Task " << taskId() << " had " << hits <<
+        std::cout << "Task " << taskId() << " had " << hits[0] <<
             " hits out of " << numThrows << " throws" << std::endl;
 
-        Hits sumHits = 0; // sum of ALL subprocess hits
-        if (!MPIOK(MPI_Barrier(comm()))) {
+        Hits sumHits[2]{ 0, 0 }; // sum of ALL subprocess hits
+        if (ErrNone != ret) {
+            // ret already set
+        }
+        else if (!mpiBarrier()) {
             ret = ErrBarrier;
         }
-        else if (!mpiReduceSumHits(hits, sumHits)) {
+        else if (!mpiReduceSumHits(hits[0], sumHits[0],
+                (s.controlVariate_ ? 2 : 1))) {
             ret = ErrReduce;
         }
         else {
+            results_.elapsedSecs_ = MPI_Wtime() - t0;
             // Manager and all subtasks have computed their values for PI. The
             // call to MPI_Reduce() has summed them all together and placed
             // result into sumHits.
-            printf("After %llu throws...\n", s.totalNumThrows_);
+            printf("After %llu throws...\n", (unsigned long long)sumThrows);
             fflush(stdout);
-            const double computedPi{ (4.0 * sumHits) / s.totalNumThrows_ };
+
+            // per-dart probability and variance of landing in the circle
+            const double n{ double(sumThrows) };
+            const double pc{ sumHits[0] / n };
+            double p{ pc };
+            double var{ pc * (1.0 - pc) };
+            double beta{ 0.0 };
+            if (s.controlVariate_) {
+                // The octagon lies inside the circle, so E[C*O] == E[O] and
+                // the octagon hits are the only extra moment Cov(C,O) needs.
+                const double po{ sumHits[1] / n };
+                const double cov{ po * (1.0 - pc) };
+                const double varO{ po * (1.0 - po) };
+                beta = ((varO > 0.0) ? (cov / varO) : 0.0);
+                p = pc - (beta * (po - OctAreaFraction));
+                var -= beta * cov;
+            }
+
+            const double computedPi{ 4.0 * p };
             const double actualPi{ 3.1415926535897 };
             const double piError{ actualPi - computedPi };
+            const double piStdErr{ 4.0 * std::sqrt(std::max(var, 0.0) / n) };
             std::cout << "  Computed PI : " << computedPi << std::endl;
             std::cout << "  Actual   PI : " << actualPi << std::endl;
             std::cout << "  Error       : " << piError << std::endl;
+            std::cout << "  Std error   : " << piStdErr << std::endl;
+            if (s.controlVariate_) {
+                std::cout << "  CV beta     : " << beta << std::endl;
+                std::cout << "  CV var gain : " << ((var > 0.0) ?
+                    ((pc * (1.0 - pc)) / var) : 0.0) << std::endl;
+            }
+
+            results_.totalNumThrows_ = sumThrows;
+            results_.sumHits_ = sumHits[0];
+            results_.computedPi_ = computedPi;
+            results_.piError_ = piError;
+            results_.piStdErr_ = piStdErr;
+            if ((0 < s.histBins_) &&
+                    (ErrNone != (ret = checkUniformity(hist, hits[0])))) {
+                // ret already set
+            }
+            else if (embedded() && !mpiBcast(&results_, sizeof(results_))) {
+                ret = ErrBcast;
+            }
         }
     }
     return ret;
@@ -79,26 +249,53 @@ MpiCalcPi::runAsWorkerImpl(const StringArray1 &args)
 {
     int ret = ErrNone;
     Settings s;
-    if (!mpiBcast(&s, sizeof(s))) {
+    // Settings are not known yet. Stick with the library algorithm and
+    // whatever wait strategy the last run on this comm left behind.
+    if (!mpiBcast(&s, sizeof(s), MPI_UNSIGNED_CHAR, RootUseManager,
+            CollLibrary)) {
         ret = ErrBcast;
     }
+    else if (ErrNone != s.argsRet_) {
+        ret = s.argsRet_; // manager could not parse the args
+    }
+    else if (!applySettings(s)) {
+        ret = ErrTune;
+    }
+    else if (0 < s.predictMaxTasks_) {
+        ret = predictScaling(s);
+    }
+    else if (0 < s.vegasIters_) {
+        ret = integrateVegas(s);
+    }
     else {
-        // Each worker task will throw this many darts.
-        const Hits numThrows = s.totalNumThrows_ / numTasks();
-
         // compute pi for this task
-        const Hits hits = throwDarts(numThrows);
+        Hits numThrows = 0;
+        Hits sumThrows = 0;
+        Hits hits[2]{ 0, 0 }; // circle hits, octagon hits
+        std::vector<Hits> hist;
+        ret = throwTaskDarts(s, numThrows, sumThrows, hits, hist);
 
-        std::cout << "Task " << taskId() << " had " << hits <<
+        std::cout << "Task " << taskId() << " had " << hits[0] <<
             " hits out of " << numThrows << " throws" << std::endl;
 
-        Hits sumHits = 0; // sum of ALL subprocess hits
-        if (!MPIOK(MPI_Barrier(comm()))) {
+        Hits sumHits[2]{ 0, 0 }; // sum of ALL subprocess hits
+        if (ErrNone != ret) {
+            // ret already set
+        }
+        else if (!mpiBarrier()) {
             ret = ErrBarrier;
         }
-        else if (!mpiReduceSumHits(hits, sumHits)) {
+        else if (!mpiReduceSumHits(hits[0], sumHits[0],
+                (s.controlVariate_ ? 2 : 1))) {
             ret = ErrReduce;
         }
+        else if ((0 < s.histBins_) &&
+                (ErrNone != (ret = checkUniformity(hist, hits[0])))) {
+            // ret already set
+        }
+        else if (embedded() && !mpiBcast(&results_, sizeof(results_))) {
+            ret = ErrBcast;
+        }
     }
     return ret;
 }
@@ -113,8 +310,226 @@ MpiCalcPi::mpiReduceSumHits(const Hits &sendbuf, Hits &recvbuf, const int count,
 }
 
 
+bool
+MpiCalcPi::applySettings(Settings &s)
+{
+    // Each task holds the full radius and angle histograms plus its
+    // reduced slice. Keep them inside the per-task memory budget.
+    const uint64_t histBytes{ 4 * sizeof(Hits) };
+    if ((0 != taskBufferBytes()) &&
+            (uint64_t(s.histBins_) > (taskBufferBytes() / histBytes))) {
+        s.histBins_ = int(taskBufferBytes() / histBytes);
+        if (managerTaskId() == taskId()) {
+            std::cout << ">> histBins capped at " << s.histBins_ <<
+                " by the memory limit" << std::endl;
+        }
+    }
+
+    bool ret = true;
+    setWaitStrategy(s.waitStrategy_);
+    setCollAlgo(s.collAlgo_);
+    if ((CollAuto == s.collAlgo_) && reduceTable().empty()) {
+        ret = mpiTuneCollectives();
+        if (ret && (managerTaskId() == taskId())) {
+            printf("Collective crossover table:\n");
+            printf("%10s %-10s %-10s\n", "max bytes", "reduce", "bcast");
+            for (std::size_t i = 0; i < reduceTable().size(); ++i) {
+                printf("%10d %-10s %-10s\n", reduceTable()[i].maxBytes_,
+                    toString(reduceTable()[i].algo_),
+                    toString(bcastTable()[i].algo_));
+            }
+            fflush(stdout);
+        }
+    }
+    return ret;
+}
+
+
+int
+MpiCalcPi::integrateVegas(const Settings &s)
+{
+    // Same budget as the darts, spread over warm up and counted iterations.
+    VegasSettings vs;
+    vs.numIters_ = s.vegasIters_;
+    vs.numEvals_ = std::max(s.totalNumThrows_ /
+        Hits(vs.numAdaptIters_ + vs.numIters_), Hits(2));
+
+    // quarter of the unit circle, scaled up to the whole circle
+    auto quarterCircle = [](const double *x)->double {
+        return ((((x[0] * x[0]) + (x[1] * x[1])) <= 1.0) ? 4.0 : 0.0);
+    };
+
+    int ret = ErrNone;
+    VegasResult vr;
+    const double t0 = MPI_Wtime();
+    if (!mpiVegas(quarterCircle, vs, vr)) {
+        ret = ErrVegas;
+    }
+    else {
+        const double actualPi{ 3.1415926535897 };
+        results_.elapsedSecs_ = MPI_Wtime() - t0;
+        results_.totalNumThrows_ = vs.numEvals_ *
+            Hits(vs.numAdaptIters_ + vs.numIters_);
+        results_.computedPi_ = vr.integral_;
+        results_.piError_ = actualPi - vr.integral_;
+        results_.piStdErr_ = vr.stdErr_;
+        if (managerTaskId() == taskId()) {
+            printf("After %d VEGAS iterations of %llu evals...\n",
+                vs.numAdaptIters_ + vs.numIters_,
+                (unsigned long long)vs.numEvals_);
+            fflush(stdout);
+            std::cout << "  Computed PI : " << vr.integral_ << std::endl;
+            std::cout << "  Actual   PI : " << actualPi << std::endl;
+            std::cout << "  Error       : " << results_.piError_ << std::endl;
+            std::cout << "  Std error   : " << vr.stdErr_ << std::endl;
+            std::cout << "  Chi2/dof    : " << vr.chi2PerDof_ << std::endl;
+        }
+    }
+    return ret;
+}
+
+
+int
+MpiCalcPi::predictScaling(const Settings &s)
+{
+    // Time a sample of throws on every task. The slowest task sets the pace.
+    const Hits numDarts{ std::max(std::min(s.totalNumThrows_ / numTasks(),
+        Hits(1e6)), Hits(1000)) };
+    const double t0 = MPI_Wtime();
+    Hits octHits = 0;
+    throwDarts(numDarts, (s.controlVariate_ ? &octHits : nullptr));
+    const double secsPerDart{ (MPI_Wtime() - t0) / numDarts };
+
+    int ret = ErrNone;
+    double maxSecsPerDart = 0.0;
+    LogGPModel::Params params;
+    bool interNode = false;
+    double wakeSecs[NumWaitStrategies]{ 0.0, 0.0 };
+    if (!mpiReduce(&secsPerDart, &maxSecsPerDart, 1, MPI_DOUBLE, MPI_MAX)) {
+        ret = ErrReduce;
+    }
+    else if (!mpiMeasureLogGP(params, interNode) ||
+            !mpiMeasureWakeSecs(WaitBackoff, wakeSecs[WaitBackoff])) {
+        ret = ErrPredict;
+    }
+    else if (managerTaskId() == taskId()) {
+        if (numTasks() < 2) {
+            std::cout << "Single task run. Communication costs are not "
+                "measured and predicted as zero." << std::endl;
+        }
+        printf("Measured on %d tasks (%llu throws per task):\n", numTasks(),
+            (unsigned long long)numDarts);
+        if (numTasks() > 1) {
+            printf("  partner   : %s\n", (interNode ? "other node" :
+                "same node - interconnect costs not measured"));
+        }
+        printf("  secs/dart : %.4e\n", maxSecsPerDart);
+        printf("  L         : %.4e\n", params.L_);
+        printf("  o         : %.4e\n", params.o_);
+        printf("  g         : %.4e\n", params.g_);
+        printf("  G         : %.4e\n", params.G_);
+        printf("  wake      : %.4e (backoff, over block)\n",
+            wakeSecs[WaitBackoff]);
+        printf("Predicted for %llu throws:\n",
+            (unsigned long long)s.totalNumThrows_);
+        printf("%10s %-10s %-10s %12s %12s %8s\n", "tasks", "wait",
+            "reduce", "comm secs", "total secs", "eff");
+
+        const LogGPModel model(params, maxSecsPerDart);
+        // powers of two up to and including predictMaxTasks_
+        for (int n = 1; n > 0; n = ((s.predictMaxTasks_ == n) ? 0 :
+                (n + std::min(n, s.predictMaxTasks_ - n)))) {
+            for (int w = WaitBlock; w < NumWaitStrategies; ++w) {
+                LogGPModel::Prediction best;
+                for (int a = CollLibrary; a <= CollAuto; ++a) {
+                    LogGPModel::Prediction p;
+                    if (CollAuto == a) {
+                        p = best; // tuning picks the fastest
+                    }
+                    else {
+                        p = model.predict(n, s.totalNumThrows_,
+                            sizeof(Settings), toReduceAlgo(CollAlgo(a)),
+                            wakeSecs[w]);
+                    }
+                    if ((CollLibrary == a) || (p.total_ < best.total_)) {
+                        best = p;
+                    }
+                    printf("%10d %-10s %-10s %12.4e %12.4e %7.1f%%\n", n,
+                        toString(WaitStrategy(w)), toString(CollAlgo(a)),
+                        p.total_ - p.compute_, p.total_,
+                        100.0 * p.efficiency_);
+                }
+            }
+        }
+        fflush(stdout);
+    }
+    return ret;
+}
+
+
+int
+MpiCalcPi::throwTaskDarts(const Settings &s, Hits &numThrows,
+    Hits &sumThrows, Hits *hits, std::vector<Hits> &hist) const
+{
+    int ret = ErrNone;
+    Hits *octHits = (s.controlVariate_ ? &hits[1] : nullptr);
+    if (0 < s.histBins_) {
+        // Round up so every task owns the same number of bins of each
+        // histogram. Radius and angle bins are stored task by task.
+        const int binsPerTask = (s.histBins_ + numTasks() - 1) / numTasks();
+        hist.assign(2 * std::size_t(binsPerTask) * numTasks(), 0);
+    }
+    uint64_t fileBytes = 0;
+    MappedFile darts;
+    if ('\0' == s.dartsFile_[0]) {
+        // Manager task also picks up any throws lost to integer truncation.
+        numThrows = (s.totalNumThrows_ / numTasks()) +
+            ((managerTaskId() == taskId()) ?
+                (s.totalNumThrows_ % numTasks()) : 0);
+        sumThrows = s.totalNumThrows_;
+        hits[0] = throwDarts(numThrows, octHits, &hist);
+    }
+    else {
+        // Contiguous blocks of darts. Low tasks pick up the remainder.
+        const Hits numTasksH{ Hits(numTasks()) };
+        const Hits taskH{ Hits(taskId()) };
+        if (!MappedFile::fileSize(s.dartsFile_, fileBytes)) {
+            ret = ErrDartsFile;
+        }
+        sumThrows = fileBytes / DartBytes;
+        if (0 == sumThrows) {
+            ret = ErrDartsFile; // not even one dart to score
+        }
+        const Hits rem{ sumThrows % numTasksH };
+        const Hits first{ ((sumThrows / numTasksH) * taskH) +
+            std::min(taskH, rem) };
+        numThrows = (sumThrows / numTasksH) + ((taskH < rem) ? 1 : 0);
+        if ((ErrNone == ret) && !darts.open(s.dartsFile_, first * DartBytes,
+                numThrows * DartBytes)) {
+            ret = ErrDartsFile;
+        }
+
+        // The path came from the manager and may not exist on every node.
+        // Fail together so no task is left waiting in a collective.
+        int anyRet = ret;
+        if (!MPIOK(MPI_Allreduce(&ret, &anyRet, 1, MPI_INT, MPI_MAX,
+                comm()))) {
+            ret = ErrDartsFile;
+        }
+        else if (ErrNone != anyRet) {
+            ret = anyRet;
+        }
+        else {
+            hits[0] = throwDarts(darts, octHits, &hist);
+        }
+    }
+    return ret;
+}
+
+
 MpiCalcPi::Hits
-MpiCalcPi::throwDarts(const Hits numDarts) const
+MpiCalcPi::throwDarts(const Hits numDarts, Hits *octHits,
+    std::vector<Hits> *hist) const
 {
     std::hash<long long> hll;
     const std::size_t rngSeed{ hll(hll(taskId() + time(nullptr)) +
@@ -122,23 +537,102 @@ MpiCalcPi::throwDarts(const Hits numDarts) const
     // The random number generator
     std::mt19937_64 rng(rngSeed);
     constexpr auto rngSpan{ rng.max() - rng.min() };
-    auto randCoordSquared = [&rng, rngSpan]()->double {
+    auto randCoord = [&rng, rngSpan]()->double {
         // calc random coord [-1.0, 1.0]
-        const double coord{ ((2.0 * (rng() - rng.min())) / rngSpan) - 1.0 };
-        return coord * coord;
+        return ((2.0 * (rng() - rng.min())) / rngSpan) - 1.0;
     };
 
     // throw darts at unit-circle dart board
-    Hits hits = 0;
-    for (Hits n = 0; n < numDarts; ++n) {
-        // Is (x^2 + y^2) <= 1.0^2 ?
-        if ((randCoordSquared() + randCoordSquared()) <= 1.0) {
-            // dart landed in circle! Increment hits.
-            ++hits;
+    return scoreHits(numDarts, randCoord, octHits, hist, numTasks());
+}
+
+
+MpiCalcPi::Hits
+MpiCalcPi::throwDarts(const MappedFile &darts, Hits *octHits,
+    std::vector<Hits> *hist) const
+{
+    // Straight off the mapped pages. No copies, no parsing.
+    const double *coord = reinterpret_cast<const double*>(darts.data());
+    auto fileCoord = [&coord]()->double {
+        return *coord++;
+    };
+    return scoreHits(darts.size() / DartBytes, fileCoord, octHits, hist,
+        numTasks());
+}
+
+
+int
+MpiCalcPi::checkUniformity(const std::vector<Hits> &hist,
+    const Hits localHits)
+{
+    // Every task ends up with its own slice of both global histograms.
+    const int numBins = int(hist.size() / 2);
+    const int binsPerTask = numBins / numTasks();
+    std::vector<Hits> slice(2 * std::size_t(binsPerTask));
+    Hits sumHits = 0;
+    int ret = ErrNone;
+    if (!mpiReduceScatterBlock(hist.data(), slice.data(), 2 * binsPerTask,
+            MPI_UINT64_T, MPI_SUM)) {
+        ret = ErrReduce;
+    }
+    else if (!mpiReduce(&localHits, &sumHits, 1, MPI_UINT64_T, MPI_SUM) ||
+            !mpiBcast(&sumHits, 1, MPI_UINT64_T)) {
+        ret = ErrReduce;
+    }
+    else {
+        // Goodness of fit over the bins this task owns. Chi2 partials add
+        // up and standardized residuals max up across tasks.
+        const double expected{ double(sumHits) / numBins };
+        double chi2[2]{ 0.0, 0.0 };     // radius, angle
+        double maxResid[2]{ 0.0, 0.0 };
+        for (int h = 0; (h < 2) && (expected > 0.0); ++h) {
+            for (int b = 0; b < binsPerTask; ++b) {
+                const double diff{ double(slice[(h * binsPerTask) + b]) -
+                    expected };
+                chi2[h] += (diff * diff) / expected;
+                maxResid[h] = std::max(maxResid[h],
+                    std::fabs(diff) / std::sqrt(expected));
+            }
+        }
+
+        double sumChi2[2]{ 0.0, 0.0 };
+        double sumMaxResid[2]{ 0.0, 0.0 };
+        if (!mpiReduce(chi2, sumChi2, 2, MPI_DOUBLE, MPI_SUM) ||
+                !mpiReduce(maxResid, sumMaxResid, 2, MPI_DOUBLE, MPI_MAX)) {
+            ret = ErrReduce;
+        }
+        else if (managerTaskId() == taskId()) {
+            // Wilson-Hilferty: (chi2/dof)^(1/3) is close to normal
+            const double dof{ double(numBins - 1) };
+            const double var{ 2.0 / (9.0 * dof) };
+            const char *names[2]{ "radius^2", "angle" };
+            printf("Uniformity of %llu hits over %d bins...\n",
+                (unsigned long long)sumHits, numBins);
+            printf("  %-10s %12s %10s %10s\n", "", "chi2/dof", "z",
+                "max resid");
+            for (int h = 0; h < 2; ++h) {
+                const double z{ (std::cbrt(sumChi2[h] / dof) -
+                    (1.0 - var)) / std::sqrt(var) };
+                printf("  %-10s %12.4f %10.3f %10.3f\n", names[h],
+                    sumChi2[h] / dof, z, sumMaxResid[h]);
+            }
+            fflush(stdout);
         }
     }
+    return ret;
+}
 
-    return hits;
+
+LogGPModel::ReduceAlgo
+MpiCalcPi::toReduceAlgo(const CollAlgo algo)
+{
+    switch (algo) {
+    case CollRecursiveDoubling: return LogGPModel::ReduceRecDoubling;
+    case CollRing:              return LogGPModel::ReduceRing;
+    default:                    break;
+    }
+    // MPI libraries reduce a few bytes over a binomial tree
+    return LogGPModel::ReduceBinomial;
 }
 
 
@@ -159,6 +653,75 @@ MpiCalcPi::processArgs(const StringArray1 &args, Settings &s)
             std::cout << ">> set totalNumThrows=" << s.totalNumThrows_ <<
                 std::endl;
         }
+        else if (("-p" == arg) || ("--predict" == arg)) {
+            if (++it == args.cend()) {
+                ret = ErrArgs;
+                break;
+            }
+            std::stringstream ss(*it);
+            ss >> s.predictMaxTasks_;
+            std::cout << ">> set predictMaxTasks=" << s.predictMaxTasks_ <<
+                std::endl;
+        }
+        else if (("-v" == arg) || ("--vegas" == arg)) {
+            if (++it == args.cend()) {
+                ret = ErrArgs;
+                break;
+            }
+            std::stringstream ss(*it);
+            ss >> s.vegasIters_;
+            std::cout << ">> set vegasIters=" << s.vegasIters_ << std::endl;
+        }
+        else if (("-w" == arg) || ("--wait" == arg)) {
+            if (++it == args.cend()) {
+                ret = ErrArgs;
+                break;
+            }
+            s.waitStrategy_ = toWaitStrategy(*it);
+            if (NumWaitStrategies == s.waitStrategy_) {
+                ret = ErrArgs;
+                break;
+            }
+            std::cout << ">> set waitStrategy=" << toString(s.waitStrategy_) <<
+                std::endl;
+        }
+        else if (("-f" == arg) || ("--darts-file" == arg)) {
+            if ((++it == args.cend()) ||
+                    (it->size() >= sizeof(s.dartsFile_))) {
+                ret = ErrArgs;
+                break;
+            }
+            it->copy(s.dartsFile_, it->size());
+            s.dartsFile_[it->size()] = '\0';
+            std::cout << ">> set dartsFile=" << s.dartsFile_ << std::endl;
+        }
+        else if ("--hist" == arg) {
+            if (++it == args.cend()) {
+                ret = ErrArgs;
+                break;
+            }
+            std::stringstream ss(*it);
+            ss >> s.histBins_;
+            std::cout << ">> set histBins=" << s.histBins_ << std::endl;
+        }
+        else if ("--cv" == arg) {
+            s.controlVariate_ = true;
+            std::cout << ">> set controlVariate=" << s.controlVariate_ <<
+                std::endl;
+        }
+        else if (("-c" == arg) || ("--collectives" == arg)) {
+            if (++it == args.cend()) {
+                ret = ErrArgs;
+                break;
+            }
+            s.collAlgo_ = toCollAlgo(*it);
+            if (NumCollAlgos == s.collAlgo_) {
+                ret = ErrArgs;
+                break;
+            }
+            std::cout << ">> set collAlgo=" << toString(s.collAlgo_) <<
+                std::endl;
+        }
     }
     return ret;
 }
@@ -3,6 +3,7 @@
 
 #include "MpiProcess.h"
 
+class MappedFile;
 struct Settings;
 
 
@@ -15,11 +16,27 @@ public:
     using Hits = uint64_t;
     static_assert(sizeof(Hits) == sizeof(unsigned long long), "Size mismatch");
 
+    // Outcome of one calcPi() call. Identical on every task.
+    struct Results {
+        int     ret_{ ErrNone };
+        Hits    totalNumThrows_{ 0 };
+        Hits    sumHits_{ 0 };
+        double  computedPi_{ 0.0 };
+        double  piError_{ 0.0 };
+        double  piStdErr_{ 0.0 };   // one sigma of computedPi_
+        double  elapsedSecs_{ 0.0 }; // manager's throw + reduce wall time
+    };
+
 public:
-    MpiCalcPi();
+    MpiCalcPi(const MPI_Comm comm = MPI_COMM_WORLD,
+        const int managerTaskId = 0);
 
     ~MpiCalcPi();
 
+    // Library entry point. Runs on the ctor's comm inside a host that
+    // already owns MPI. See MpiProcess::runEmbedded().
+    Results     calcPi(const StringArray1 &args);
+
 private:
     int         runAsManagerImpl(const StringArray1 &args) override;
 
@@ -29,10 +46,47 @@ private:
                     const int count = 1, const int root = -1);
 
 
-    Hits        throwDarts(const Hits numDarts) const;
+    // Sets the wait strategy and collective algorithm, tuning if needed,
+    // and trims s to the resource limits. Collective.
+    bool        applySettings(Settings &s);
+
+    int         integrateVegas(const Settings &s);
+
+    int         predictScaling(const Settings &s);
+
+    // Throws this task's share of the darts, generated or read from
+    // Settings::dartsFile_. hits[0] gets circle hits and hits[1] octagon
+    // hits when the control variate is on. hist gets this task's radius and
+    // angle histograms when Settings::histBins_ asks for them. Collective
+    // when reading a darts file - every task fails if any task cannot read it.
+    int         throwTaskDarts(const Settings &s, Hits &numThrows,
+                    Hits &sumThrows, Hits *hits,
+                    std::vector<Hits> &hist) const;
+
+    // Returns circle hits. Also counts inscribed octagon hits into octHits
+    // when given - the control variate - and bins the hits into a non-empty
+    // hist.
+    Hits        throwDarts(const Hits numDarts, Hits *octHits = nullptr,
+                    std::vector<Hits> *hist = nullptr) const;
+
+    // Same as above for the darts in a mapped darts file.
+    Hits        throwDarts(const MappedFile &darts, Hits *octHits = nullptr,
+                    std::vector<Hits> *hist = nullptr) const;
+
+    // Combines the tasks' histograms with a reduce-scatter so every task
+    // owns a slice of the bins and tests it locally. Only the chi2 and
+    // residual statistics reach the manager.
+    int         checkUniformity(const std::vector<Hits> &hist,
+                    const Hits localHits);
 
 
     static int  processArgs(const StringArray1 &args, Settings &s);
+
+    // Message pattern LogGPModel uses to price algo. Not valid for CollAuto.
+    static LogGPModel::ReduceAlgo toReduceAlgo(const CollAlgo algo);
+
+private:
+    Results     results_;
 };
 
 #endif // MPICALCPI_H
@@ -1,8 +1,14 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <random>
 #include <string>
 #include <sstream>
+#include <thread>
 
 #include "MpiProcess.h"
+#include "VegasGrid.h"
 
 
 MpiProcess::MpiProcess(const MPI_Comm Comm, const int managerTaskId) :
@@ -24,24 +30,80 @@ MpiProcess::run(const int argc, char *argv[])
     if (!MPIOK(MPI_Init(&argc, &argv))) {
         ret = ErrInit; // fail
     }
-    else if (!MPIOK(MPI_Comm_size(comm_, &numTasks_))) {
+    else {
+        StringArray1 args;
+        args.insert(args.end(), argv + 1, argv + argc);
+        ret = runTasks(args);
+    }
+
+    // always call MPI_Finalize(). Don't change ret if error is already set.
+    if (!MPIOK(MPI_Finalize()) && (ErrNone == ret)) {
+        // All was okay until MPI_Finalize()
+        ret = ErrFinalize;
+    }
+
+    std::cout << "MPI task " << getTaskName() << " ending" << std::endl;
+    return ret;
+}
+
+
+int
+MpiProcess::runEmbedded(const StringArray1 &args)
+{
+    int ret = ErrNone;
+    int initialized = 0;
+    int finalized = 0;
+    const MPI_Comm hostComm = comm_;
+    if (!MPIOK(MPI_Initialized(&initialized)) || !initialized) {
+        ret = ErrInit; // host must own MPI
+    }
+    else if (!MPIOK(MPI_Finalized(&finalized)) || finalized) {
+        ret = ErrInit; // too late
+    }
+    else if (!MPIOK(MPI_Comm_dup(hostComm, &comm_))) {
+        // Private comm keeps our messages from matching the host's.
+        comm_ = hostComm;
+        ret = ErrCommDup;
+    }
+    else {
+        embedded_ = true;
+        ret = runTasks(args);
+        embedded_ = false;
+
+        std::cout << "MPI task " << getTaskName() << " ending" << std::endl;
+
+        // always free the dup. Don't change ret if error is already set.
+        if (!MPIOK(MPI_Comm_free(&comm_)) && (ErrNone == ret)) {
+            ret = ErrCommDup;
+        }
+        comm_ = hostComm;
+    }
+    return ret;
+}
+
+
+int
+MpiProcess::runTasks(const StringArray1 &args)
+{
+    int ret = ErrNone;
+    if (!MPIOK(MPI_Comm_size(comm_, &numTasks_))) {
         ret = ErrCommSize; // fail
     }
     else if (!MPIOK(MPI_Comm_rank(comm_, &taskId_))) {
         ret = ErrCommRank; // fail
     }
+    else if (!mpiDetectLimits()) {
+        ret = ErrLimits; // fail
+    }
     else {
         std::cout << "MPI task " << getTaskName() << " started" <<
             std::endl;
 
-        if (syncStarts_ && !MPIOK(MPI_Barrier(comm_))) {
+        if (syncStarts_ && !mpiBarrier()) {
             // Process start sync requested and failed
             ret = ErrBarrier;
         }
         else {
-            StringArray1 args;
-            args.insert(args.end(), argv + 1, argv + argc);
-
             if (managerTaskId_ == taskId_) {
                 ret = runAsManager(args);
             }
@@ -52,39 +114,540 @@ MpiProcess::run(const int argc, char *argv[])
             if (ErrNone != ret) {
                 // ret already set - do not sync ends
             }
-            else if (syncEnds_ && !MPIOK(MPI_Barrier(comm_))) {
+            else if (syncEnds_ && !mpiBarrier()) {
                 // Process end sync requested and failed
                 ret = ErrBarrier;
             }
         }
     }
+    return ret;
+}
 
-    // always call MPI_Finalize(). Don't change ret if error is already set.
-    if (!MPIOK(MPI_Finalize()) && (ErrNone == ret)) {
-        // All was okay until MPI_Finalize()
-        ret = ErrFinalize;
+
+bool
+MpiProcess::mpiDetectLimits()
+{
+    resourceLimits_.detect();
+
+    // Limits are per node. Count the tasks sharing ours and the CPUs any of
+    // them may run on, then agree on the worst case so every task makes the
+    // same sizing decisions.
+    ResourceLimits::CpuMask nodeAffinity(resourceLimits_.affinity());
+    MPI_Comm nodeComm = MPI_COMM_NULL;
+    bool ret = MPIOK(MPI_Comm_split_type(comm_, MPI_COMM_TYPE_SHARED,
+        taskId_, MPI_INFO_NULL, &nodeComm)) &&
+        MPIOK(MPI_Comm_size(nodeComm, &numNodeTasks_)) &&
+        MPIOK(MPI_Allreduce(MPI_IN_PLACE, nodeAffinity.data(),
+            int(nodeAffinity.size()), MPI_UINT64_T, MPI_BOR, nodeComm));
+    if (ret) {
+        resourceLimits_.setNodeAffinity(nodeAffinity);
+    }
+    if (MPI_COMM_NULL != nodeComm) {
+        MPI_Comm_free(&nodeComm);
     }
 
-    std::cout << "MPI task " << getTaskName() << " ending" << std::endl;
+    int over = (numNodeTasks_ > resourceLimits_.effectiveCpus()) ? 1 : 0;
+    uint64_t memBytes = ((0 == resourceLimits_.memoryBytes()) ? UINT64_MAX :
+        (resourceLimits_.memoryBytes() / uint64_t(numNodeTasks_)));
+    ret = ret &&
+        MPIOK(MPI_Allreduce(MPI_IN_PLACE, &over, 1, MPI_INT, MPI_MAX,
+            comm_)) &&
+        MPIOK(MPI_Allreduce(MPI_IN_PLACE, &memBytes, 1, MPI_UINT64_T,
+            MPI_MIN, comm_));
+    oversubscribed_ = (0 != over);
+    taskMemoryBytes_ = ((UINT64_MAX == memBytes) ? 0 : memBytes);
     return ret;
 }
 
 
 bool
 MpiProcess::mpiReduce(const void* sendbuf, void* recvbuf, const int count,
-    const MPI_Datatype datatype, const MPI_Op op, const int root)
+    const MPI_Datatype datatype, const MPI_Op op, const int root,
+    const CollAlgo algo)
 {
-    return MPIOK(MPI_Reduce(sendbuf, recvbuf, count, datatype, op,
-        ((RootUseManager == root) ? managerTaskId_ : root), comm_));
+    const int rootId = ((RootUseManager == root) ? managerTaskId_ : root);
+    int typeSize = 0;
+    int commute = 0;
+    CollAlgo useAlgo = CollLibrary;
+    // Only decide on inputs every task shares. MPI_IN_PLACE is only
+    // passed by root.
+    if ((numTasks_ < 2) || !isNamedType(datatype) ||
+            !MPIOK(MPI_Type_size(datatype, &typeSize)) ||
+            !MPIOK(MPI_Op_commutative(op, &commute)) || !commute) {
+        // library handles everything the hand-rolled algorithms do not
+    }
+    else {
+        useAlgo = resolveCollAlgo(algo, count * typeSize, reduceTable_);
+    }
+
+    // in place root contributes what is already in recvbuf
+    const void *src = ((MPI_IN_PLACE == sendbuf) ? recvbuf : sendbuf);
+    bool ret = false;
+    switch (useAlgo) {
+    case CollBinomial:
+        ret = reduceBinomial(src, recvbuf, count, datatype, op, rootId);
+        break;
+    case CollRecursiveDoubling:
+        ret = reduceRecursiveDoubling(src, recvbuf, count, datatype, op,
+            rootId);
+        break;
+    case CollRing:
+        ret = reduceRing(src, recvbuf, count, datatype, op, rootId);
+        break;
+    default:
+        if (WaitBlock == waitStrategy_) {
+            ret = MPIOK(MPI_Reduce(sendbuf, recvbuf, count, datatype, op,
+                rootId, comm_));
+        }
+        else {
+            MPI_Request req;
+            ret = MPIOK(MPI_Ireduce(sendbuf, recvbuf, count, datatype, op,
+                rootId, comm_, &req)) && mpiWaitAll(1, &req);
+        }
+        break;
+    }
+    return ret;
 }
 
 
 bool
 MpiProcess::mpiBcast(void* buf, const int count,
-    const MPI_Datatype datatype, const int root)
+    const MPI_Datatype datatype, const int root, const CollAlgo algo)
+{
+    const int rootId = ((RootUseManager == root) ? managerTaskId_ : root);
+    int typeSize = 0;
+    CollAlgo useAlgo = CollLibrary;
+    if ((numTasks_ < 2) || !isNamedType(datatype) ||
+            !MPIOK(MPI_Type_size(datatype, &typeSize))) {
+        // let the library sort it out
+    }
+    else {
+        useAlgo = resolveCollAlgo(algo, count * typeSize, bcastTable_);
+    }
+
+    bool ret = false;
+    switch (useAlgo) {
+    case CollBinomial:
+        ret = bcastBinomial(static_cast<char*>(buf), count * typeSize,
+            rootId);
+        break;
+    case CollRecursiveDoubling:
+        ret = bcastScatterAllgather(static_cast<char*>(buf),
+            count * typeSize, rootId, false);
+        break;
+    case CollRing:
+        ret = bcastScatterAllgather(static_cast<char*>(buf),
+            count * typeSize, rootId, true);
+        break;
+    default:
+        if (WaitBlock == waitStrategy_) {
+            ret = MPIOK(MPI_Bcast(buf, count, datatype, rootId, comm_));
+        }
+        else {
+            MPI_Request req;
+            ret = MPIOK(MPI_Ibcast(buf, count, datatype, rootId, comm_,
+                &req)) && mpiWaitAll(1, &req);
+        }
+        break;
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::mpiTuneCollectives(const int maxBytes, const int numIters)
+{
+    reduceTable_.clear();
+    bcastTable_.clear();
+
+    // two buffers of up to maxBytes each
+    int bufBytes = maxBytes;
+    if ((0 != taskBufferBytes()) &&
+            (uint64_t(bufBytes) > (taskBufferBytes() / 2))) {
+        bufBytes = int(taskBufferBytes() / 2);
+    }
+
+    bool ret = true;
+    std::vector<double> sendbuf;
+    std::vector<double> recvbuf;
+    for (int bytes = 8; ret && (bytes <= bufBytes); bytes *= 8) {
+        // keep total bytes moved per measurement roughly constant
+        const int iters = std::max(numIters * 4096 / std::max(bytes, 4096),
+            2);
+        const int count = bytes / int(sizeof(double));
+        sendbuf.assign(count, 1.0);
+        recvbuf.assign(count, 0.0);
+
+        CollTableEntry bestReduce{ bytes, CollLibrary };
+        CollTableEntry bestBcast{ bytes, CollLibrary };
+        double bestReduceSecs = 0.0;
+        double bestBcastSecs = 0.0;
+        for (int a = CollLibrary; ret && (a < CollAuto); ++a) {
+            const CollAlgo algo = CollAlgo(a);
+            double secs[2]{ 0.0, 0.0 };
+            ret = mpiBarrier();
+            double t0 = MPI_Wtime();
+            for (int i = 0; ret && (i < iters); ++i) {
+                ret = mpiReduce(sendbuf.data(), recvbuf.data(), count,
+                    MPI_DOUBLE, MPI_SUM, RootUseManager, algo);
+            }
+            secs[0] = (MPI_Wtime() - t0) / iters;
+            ret = ret && mpiBarrier();
+            t0 = MPI_Wtime();
+            for (int i = 0; ret && (i < iters); ++i) {
+                ret = mpiBcast(sendbuf.data(), count, MPI_DOUBLE,
+                    RootUseManager, algo);
+            }
+            secs[1] = (MPI_Wtime() - t0) / iters;
+
+            // Slowest task decides. Every task sees the same maxima, so the
+            // tables agree everywhere - CollAuto depends on that.
+            double maxSecs[2]{ 0.0, 0.0 };
+            ret = ret && MPIOK(MPI_Allreduce(secs, maxSecs, 2, MPI_DOUBLE,
+                MPI_MAX, comm_));
+            if (ret && ((CollLibrary == algo) ||
+                    (maxSecs[0] < bestReduceSecs))) {
+                bestReduceSecs = maxSecs[0];
+                bestReduce.algo_ = algo;
+            }
+            if (ret && ((CollLibrary == algo) ||
+                    (maxSecs[1] < bestBcastSecs))) {
+                bestBcastSecs = maxSecs[1];
+                bestBcast.algo_ = algo;
+            }
+        }
+        reduceTable_.push_back(bestReduce);
+        bcastTable_.push_back(bestBcast);
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::mpiReduceScatterBlock(const void* sendbuf, void* recvbuf,
+    const int count, const MPI_Datatype datatype, const MPI_Op op)
+{
+    bool ret = false;
+    if (WaitBlock == waitStrategy_) {
+        ret = MPIOK(MPI_Reduce_scatter_block(sendbuf, recvbuf, count,
+            datatype, op, comm_));
+    }
+    else {
+        MPI_Request req;
+        ret = MPIOK(MPI_Ireduce_scatter_block(sendbuf, recvbuf, count,
+            datatype, op, comm_, &req)) && mpiWaitAll(1, &req);
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::mpiBarrier()
+{
+    bool ret = false;
+    if (WaitBlock == waitStrategy_) {
+        ret = MPIOK(MPI_Barrier(comm_));
+    }
+    else {
+        MPI_Request req;
+        ret = MPIOK(MPI_Ibarrier(comm_, &req)) && mpiWaitAll(1, &req);
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::mpiWaitAll(const int count, MPI_Request *reqs)
+{
+    if (WaitBlock == waitStrategy_) {
+        return MPIOK(MPI_Waitall(count, reqs, MPI_STATUSES_IGNORE));
+    }
+
+    bool ret = true;
+    int done = 0;
+    int numTests = 0;
+    int sleepUsecs = 1;
+    const int maxSleepUsecs = WaitMaxSleepUsecs; // std::min() binds a ref
+    while (ret && !done) {
+        ret = MPIOK(MPI_Testall(count, reqs, &done, MPI_STATUSES_IGNORE));
+        if (!ret || done) {
+            // finished one way or the other
+        }
+        else if (numTests < WaitSpinTests) {
+            ++numTests; // cheapest if the peers are nearly there
+        }
+        else if (numTests < (WaitSpinTests + WaitYieldTests)) {
+            ++numTests;
+            std::this_thread::yield();
+        }
+        else {
+            std::this_thread::sleep_for(
+                std::chrono::microseconds(sleepUsecs));
+            sleepUsecs = std::min(2 * sleepUsecs, maxSleepUsecs);
+        }
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::mpiVegas(const Integrand &f, const VegasSettings &vs,
+    VegasResult &result)
+{
+    result = VegasResult();
+    VegasGrid grid(vs.numDims_, vs.numBins_);
+
+    std::hash<long long> hll;
+    const std::size_t rngSeed{ hll(hll(taskId_ + time(nullptr)) +
+        hll(std::chrono::system_clock::now().time_since_epoch().count())) };
+    std::mt19937_64 rng(rngSeed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    // This task's share of the evals. Low tasks pick up the remainder.
+    const uint64_t numTasks64{ uint64_t(numTasks_) };
+    const uint64_t numEvals{ (vs.numEvals_ / numTasks64) +
+        ((uint64_t(taskId_) < (vs.numEvals_ % numTasks64)) ? 1 : 0) };
+    const double n{ double(vs.numEvals_) };
+
+    // [sum f*J, sum (f*J)^2, per dim and bin sum (f*J)^2]
+    const int numSums = 2 + (vs.numDims_ * vs.numBins_);
+    std::vector<double> sums(numSums);
+    std::vector<double> totals(numSums);
+    std::vector<double> u(vs.numDims_);
+    std::vector<double> x(vs.numDims_);
+    std::vector<int> bins(vs.numDims_);
+    double sumWeights = 0.0;    // sum of 1/var over counted iterations
+    double sumWeighted = 0.0;   // sum of I/var
+    double sumWeightedSq = 0.0; // sum of I^2/var
+    bool ret = true;
+    const int numIters = vs.numAdaptIters_ + vs.numIters_;
+    for (int iter = 0; ret && (iter < numIters); ++iter) {
+        std::fill(sums.begin(), sums.end(), 0.0);
+        for (uint64_t e = 0; e < numEvals; ++e) {
+            for (double &ud : u) {
+                ud = uniform(rng);
+            }
+            const double jacobian{ grid.map(u.data(), x.data(),
+                bins.data()) };
+            const double fj{ f(x.data()) * jacobian };
+            const double fj2{ fj * fj };
+            sums[0] += fj;
+            sums[1] += fj2;
+            for (int d = 0; d < vs.numDims_; ++d) {
+                sums[2 + (d * vs.numBins_) + bins[d]] += fj2;
+            }
+        }
+
+        // Everybody needs the totals to refine the same grid.
+        ret = mpiReduce(sums.data(), totals.data(), numSums, MPI_DOUBLE,
+            MPI_SUM) && mpiBcast(totals.data(), numSums, MPI_DOUBLE);
+        if (!ret) {
+            break;
+        }
+
+        const double mean{ totals[0] / n };
+        const double var{ std::max(((totals[1] / n) - (mean * mean)) /
+            (n - 1.0), 0.0) };
+        if (iter < vs.numAdaptIters_) {
+            // grid warm up only
+        }
+        else if (0.0 == var) {
+            // exact - nothing left to average or adapt
+            sumWeights = 0.0; // keep this value below
+            result.integral_ = mean;
+            result.numIters_ = 1;
+            break;
+        }
+        else {
+            sumWeights += 1.0 / var;
+            sumWeighted += mean / var;
+            sumWeightedSq += (mean * mean) / var;
+            ++result.numIters_;
+        }
+        grid.refine(totals.data() + 2, vs.alpha_);
+    }
+
+    if (ret && (sumWeights > 0.0)) {
+        result.integral_ = sumWeighted / sumWeights;
+        result.stdErr_ = std::sqrt(1.0 / sumWeights);
+        if (result.numIters_ > 1) {
+            // sum (I_i - I)^2 / var_i expanded
+            result.chi2PerDof_ = (sumWeightedSq -
+                (result.integral_ * sumWeighted)) / (result.numIters_ - 1);
+        }
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::mpiMeasureLogGP(LogGPModel::Params &params, bool &interNode,
+    const int numIters)
+{
+    // All tasks other than the manager and its partner fall straight
+    // through.
+    params = LogGPModel::Params();
+    interNode = false;
+    if (numTasks_ < 2) {
+        return true; // nobody to talk to - communication is free
+    }
+
+    int partner = -1;
+    const bool isManager = (managerTaskId_ == taskId_);
+    if (!mpiMeasurePartner(partner, interNode)) {
+        return false;
+    }
+    else if (!isManager && (partner != taskId_)) {
+        return true;
+    }
+    const int peer = (isManager ? partner : managerTaskId_);
+    const int numLongIters = std::max(numIters / 100, 2);
+    std::vector<char> buf(LogGPLongBytes, 0);
+    bool ret = true;
+
+    // round trip of nbytes, numIters times. Returns average round trip.
+    auto pingPong = [&](const int nbytes, const int iters,
+            double &sendSecs)->double {
+        sendSecs = 0.0;
+        const double t0 = MPI_Wtime();
+        for (int i = 0; ret && (i < iters); ++i) {
+            if (isManager) {
+                const double s0 = MPI_Wtime();
+                ret = MPIOK(MPI_Send(buf.data(), nbytes, MPI_CHAR, peer,
+                    TagLogGP, comm_));
+                sendSecs += MPI_Wtime() - s0;
+                ret = ret && MPIOK(MPI_Recv(buf.data(), nbytes, MPI_CHAR,
+                    peer, TagLogGP, comm_, MPI_STATUS_IGNORE));
+            }
+            else {
+                ret = MPIOK(MPI_Recv(buf.data(), nbytes, MPI_CHAR, peer,
+                    TagLogGP, comm_, MPI_STATUS_IGNORE)) &&
+                    MPIOK(MPI_Send(buf.data(), nbytes, MPI_CHAR, peer,
+                        TagLogGP, comm_));
+            }
+        }
+        sendSecs /= iters;
+        return (MPI_Wtime() - t0) / iters;
+    };
+
+    double sendSecs = 0.0;
+    double ignored = 0.0;
+    pingPong(1, 10, ignored); // warm up connection
+    const double rttShort = pingPong(1, numIters, sendSecs);
+    const double rttLong = pingPong(LogGPLongBytes, numLongIters, ignored);
+
+    // Stream of back-to-back short messages followed by one ack. The
+    // manager's send rate is bound by g.
+    const double t0 = MPI_Wtime();
+    for (int i = 0; ret && (i < numIters); ++i) {
+        ret = (isManager ?
+            MPIOK(MPI_Send(buf.data(), 1, MPI_CHAR, peer, TagLogGP, comm_)) :
+            MPIOK(MPI_Recv(buf.data(), 1, MPI_CHAR, peer, TagLogGP, comm_,
+                MPI_STATUS_IGNORE)));
+    }
+    if (!ret) {
+        // fall through
+    }
+    else if (isManager) {
+        ret = MPIOK(MPI_Recv(buf.data(), 1, MPI_CHAR, peer, TagLogGP, comm_,
+            MPI_STATUS_IGNORE));
+    }
+    else {
+        ret = MPIOK(MPI_Send(buf.data(), 1, MPI_CHAR, peer, TagLogGP, comm_));
+    }
+    const double streamSecs = MPI_Wtime() - t0;
+
+    if (ret && isManager) {
+        params.o_ = sendSecs;
+        params.L_ = std::max((rttShort / 2.0) - (2.0 * params.o_), 0.0);
+        params.g_ = std::max((streamSecs - (rttShort / 2.0)) / numIters,
+            params.o_);
+        params.G_ = std::max((rttLong - rttShort) /
+            (2.0 * (LogGPLongBytes - 1)), 0.0);
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::mpiMeasureWakeSecs(const WaitStrategy strategy, double &wakeSecs,
+    const int numIters)
+{
+    wakeSecs = 0.0;
+    int partner = -1;
+    bool interNode = false;
+    const bool isManager = (managerTaskId_ == taskId_);
+    if (numTasks_ < 2) {
+        return true; // nobody to wake
+    }
+    else if (!mpiMeasurePartner(partner, interNode)) {
+        return false;
+    }
+    else if (!isManager && (partner != taskId_)) {
+        return true;
+    }
+    const int peer = (isManager ? partner : managerTaskId_);
+
+    // The manager stays quiet long enough for the partner's wait to reach
+    // its longest sleep, then times one byte there and back.
+    const WaitStrategy savedStrategy = waitStrategy_;
+    const int idleUsecs = WaitIdleUsecs;
+    auto idleRoundTrip = [&](const WaitStrategy waitWith, bool &ok)->double {
+        waitStrategy_ = waitWith;
+        char byte = 0;
+        double secs = 0.0;
+        for (int i = 0; ok && (i < numIters); ++i) {
+            if (isManager) {
+                std::this_thread::sleep_for(
+                    std::chrono::microseconds(idleUsecs));
+                const double t0 = MPI_Wtime();
+                ok = p2pSend(&byte, 1, peer) && p2pRecv(&byte, 1, peer);
+                secs += MPI_Wtime() - t0;
+            }
+            else {
+                ok = p2pRecv(&byte, 1, peer) && p2pSend(&byte, 1, peer);
+            }
+        }
+        return secs / numIters;
+    };
+
+    bool ret = true;
+    const double blockSecs = idleRoundTrip(WaitBlock, ret);
+    const double strategySecs = idleRoundTrip(strategy, ret);
+    waitStrategy_ = savedStrategy;
+    wakeSecs = std::max(strategySecs - blockSecs, 0.0);
+    return ret;
+}
+
+
+bool
+MpiProcess::mpiMeasurePartner(int &partner, bool &interNode)
 {
-    return MPIOK(MPI_Bcast(buf, count, datatype,
-        ((RootUseManager == root) ? managerTaskId_ : root), comm_));
+    // Predictions at scale need interconnect costs, and ranks are usually
+    // placed so the manager's neighbor shares its node. Name every node by
+    // its lowest task and take the first task on a node not the manager's.
+    partner = (managerTaskId_ + 1) % numTasks_;
+    interNode = false;
+    std::vector<int> nodeOf(numTasks_, 0);
+    int node = taskId_;
+    MPI_Comm nodeComm = MPI_COMM_NULL;
+    bool ret = MPIOK(MPI_Comm_split_type(comm_, MPI_COMM_TYPE_SHARED,
+        taskId_, MPI_INFO_NULL, &nodeComm)) &&
+        MPIOK(MPI_Allreduce(&taskId_, &node, 1, MPI_INT, MPI_MIN,
+            nodeComm)) &&
+        MPIOK(MPI_Allgather(&node, 1, MPI_INT, nodeOf.data(), 1, MPI_INT,
+            comm_));
+    if (MPI_COMM_NULL != nodeComm) {
+        MPI_Comm_free(&nodeComm);
+    }
+    for (int t = 0; ret && (t < numTasks_); ++t) {
+        if (nodeOf[t] != nodeOf[managerTaskId_]) {
+            partner = t;
+            interNode = true;
+            break;
+        }
+    }
+    return ret;
 }
 
 
@@ -150,6 +713,59 @@ MpiProcess::getVersionString() const
 }
 
 
+const char *
+MpiProcess::toString(const CollAlgo algo)
+{
+    switch (algo) {
+    case CollDefault:           return "default";
+    case CollLibrary:           return "lib";
+    case CollBinomial:          return "binomial";
+    case CollRecursiveDoubling: return "recdbl";
+    case CollRing:              return "ring";
+    case CollAuto:              return "auto";
+    default:                    break;
+    }
+    return "unknown";
+}
+
+
+MpiProcess::CollAlgo
+MpiProcess::toCollAlgo(const std::string &str)
+{
+    for (int a = CollDefault; a < NumCollAlgos; ++a) {
+        if (str == toString(CollAlgo(a))) {
+            return CollAlgo(a);
+        }
+    }
+    return NumCollAlgos;
+}
+
+
+const char *
+MpiProcess::toString(const WaitStrategy strategy)
+{
+    switch (strategy) {
+    case WaitDefault:   return "default";
+    case WaitBlock:     return "block";
+    case WaitBackoff:   return "backoff";
+    default:            break;
+    }
+    return "unknown";
+}
+
+
+MpiProcess::WaitStrategy
+MpiProcess::toWaitStrategy(const std::string &str)
+{
+    for (int w = WaitDefault; w < NumWaitStrategies; ++w) {
+        if (str == toString(WaitStrategy(w))) {
+            return WaitStrategy(w);
+        }
+    }
+    return NumWaitStrategies;
+}
+
+
 int
 MpiProcess::runAsManager(const StringArray1 &args)
 {
@@ -162,3 +778,322 @@ MpiProcess::runAsWorker(const StringArray1 &args)
 {
     return this->runAsWorkerImpl(args);
 }
+
+
+MpiProcess::CollAlgo
+MpiProcess::resolveCollAlgo(const CollAlgo algo, const int bytes,
+    const CollTable &table) const
+{
+    CollAlgo ret = ((CollDefault == algo) ? collAlgo_ : algo);
+    if (CollAuto == ret) {
+        // Untuned tables fall back to the library. Past the last entry,
+        // the largest measured payload's winner is the best guess.
+        ret = (table.empty() ? CollLibrary : table.back().algo_);
+        for (const CollTableEntry &entry : table) {
+            if (bytes <= entry.maxBytes_) {
+                ret = entry.algo_;
+                break;
+            }
+        }
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::isNamedType(const MPI_Datatype datatype) const
+{
+    int numInts = 0;
+    int numAddrs = 0;
+    int numTypes = 0;
+    int combiner = MPI_COMBINER_NAMED;
+    return MPIOK(MPI_Type_get_envelope(datatype, &numInts, &numAddrs,
+        &numTypes, &combiner)) && (MPI_COMBINER_NAMED == combiner);
+}
+
+
+bool
+MpiProcess::reduceBinomial(const void* sendbuf, void* recvbuf,
+    const int count, const MPI_Datatype datatype, const MPI_Op op,
+    const int root)
+{
+    int typeSize = 0;
+    MPI_Type_size(datatype, &typeSize);
+    const int bytes = count * typeSize;
+    const char *src = static_cast<const char*>(sendbuf);
+    std::vector<char> acc(src, src + bytes);
+    std::vector<char> tmp(bytes);
+
+    // Ranks relative to root. Every round, the odd multiples of mask hand
+    // their partial result down to vtask - mask and drop out.
+    const int vtask = (taskId_ - root + numTasks_) % numTasks_;
+    bool ret = true;
+    for (int mask = 1; ret && (mask < numTasks_); mask <<= 1) {
+        if (0 != (vtask & mask)) {
+            ret = p2pSend(acc.data(), bytes,
+                (vtask - mask + root) % numTasks_);
+            break;
+        }
+        else if ((vtask + mask) < numTasks_) {
+            ret = p2pRecv(tmp.data(), bytes,
+                (vtask + mask + root) % numTasks_) &&
+                MPIOK(MPI_Reduce_local(tmp.data(), acc.data(), count,
+                    datatype, op));
+        }
+    }
+    if (ret && (0 == vtask)) {
+        std::copy(acc.begin(), acc.end(), static_cast<char*>(recvbuf));
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::reduceRecursiveDoubling(const void* sendbuf, void* recvbuf,
+    const int count, const MPI_Datatype datatype, const MPI_Op op,
+    const int root)
+{
+    int typeSize = 0;
+    MPI_Type_size(datatype, &typeSize);
+    const int bytes = count * typeSize;
+    const char *src = static_cast<const char*>(sendbuf);
+    std::vector<char> acc(src, src + bytes);
+    std::vector<char> tmp(bytes);
+
+    // Fold the tasks beyond the largest power of two into their even
+    // neighbors, butterfly over the rest, then unfold if root was folded.
+    int pof2 = 1;
+    while ((pof2 * 2) <= numTasks_) {
+        pof2 *= 2;
+    }
+    const int rem = numTasks_ - pof2;
+    int newTask = taskId_ - rem;
+    bool ret = true;
+    if (taskId_ < (2 * rem)) {
+        if (0 == (taskId_ % 2)) {
+            ret = p2pSend(acc.data(), bytes, taskId_ + 1);
+            newTask = -1;
+        }
+        else {
+            ret = p2pRecv(tmp.data(), bytes, taskId_ - 1) &&
+                MPIOK(MPI_Reduce_local(tmp.data(), acc.data(), count,
+                    datatype, op));
+            newTask = taskId_ / 2;
+        }
+    }
+
+    for (int mask = 1; ret && (-1 != newTask) && (mask < pof2); mask <<= 1) {
+        const int newPeer = newTask ^ mask;
+        const int peer = ((newPeer < rem) ? ((newPeer * 2) + 1) :
+            (newPeer + rem));
+        ret = p2pSendrecv(acc.data(), bytes, peer, tmp.data(), bytes, peer) &&
+            MPIOK(MPI_Reduce_local(tmp.data(), acc.data(), count, datatype,
+                op));
+    }
+
+    if (!ret || (taskId_ >= (2 * rem))) {
+        // not folded
+    }
+    else if ((0 != (taskId_ % 2)) && ((taskId_ - 1) == root)) {
+        ret = p2pSend(acc.data(), bytes, root);
+    }
+    else if ((0 == (taskId_ % 2)) && (root == taskId_)) {
+        ret = p2pRecv(acc.data(), bytes, taskId_ + 1);
+    }
+
+    if (ret && (root == taskId_)) {
+        std::copy(acc.begin(), acc.end(), static_cast<char*>(recvbuf));
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::reduceRing(const void* sendbuf, void* recvbuf, const int count,
+    const MPI_Datatype datatype, const MPI_Op op, const int root)
+{
+    int typeSize = 0;
+    MPI_Type_size(datatype, &typeSize);
+    const char *src = static_cast<const char*>(sendbuf);
+    std::vector<char> acc(src, src + (count * typeSize));
+
+    // Block b holds elements [first(b), first(b + 1)).
+    auto first = [count, this](const int b)->int {
+        return int((int64_t(count) * b) / numTasks_); };
+    auto blockPtr = [&](const int b)->char* {
+        return acc.data() + (first(b) * typeSize); };
+    auto blockCount = [&](const int b)->int {
+        return first(b + 1) - first(b); };
+
+    // reduce-scatter: after P-1 steps, task t holds the complete block t+1.
+    const int right = (taskId_ + 1) % numTasks_;
+    const int left = (taskId_ - 1 + numTasks_) % numTasks_;
+    std::vector<char> tmp(((count / numTasks_) + 1) * typeSize);
+    bool ret = true;
+    for (int step = 0; ret && (step < (numTasks_ - 1)); ++step) {
+        const int sendBlock = (taskId_ - step + numTasks_) % numTasks_;
+        const int recvBlock = (taskId_ - step - 1 + numTasks_) % numTasks_;
+        ret = p2pSendrecv(blockPtr(sendBlock),
+            blockCount(sendBlock) * typeSize, right, tmp.data(),
+            blockCount(recvBlock) * typeSize, left) &&
+            MPIOK(MPI_Reduce_local(tmp.data(), blockPtr(recvBlock),
+                blockCount(recvBlock), datatype, op));
+    }
+
+    // gather the finished blocks at root
+    const int ownBlock = (taskId_ + 1) % numTasks_;
+    if (!ret) {
+        // fall through
+    }
+    else if (root != taskId_) {
+        ret = p2pSend(blockPtr(ownBlock), blockCount(ownBlock) * typeSize,
+            root);
+    }
+    else {
+        char *dst = static_cast<char*>(recvbuf);
+        for (int t = 0; ret && (t < numTasks_); ++t) {
+            const int b = (t + 1) % numTasks_;
+            if (t == taskId_) {
+                std::copy(blockPtr(b), blockPtr(b) + (blockCount(b) *
+                    typeSize), dst + (first(b) * typeSize));
+            }
+            else {
+                ret = p2pRecv(dst + (first(b) * typeSize),
+                    blockCount(b) * typeSize, t);
+            }
+        }
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::bcastBinomial(char* buf, const int bytes, const int root)
+{
+    // Receive from the parent at our lowest set bit, then feed the children
+    // at each smaller power of two.
+    const int vtask = (taskId_ - root + numTasks_) % numTasks_;
+    bool ret = true;
+    int mask = 1;
+    for (; mask < numTasks_; mask <<= 1) {
+        if (0 != (vtask & mask)) {
+            ret = p2pRecv(buf, bytes, (vtask - mask + root) % numTasks_);
+            break;
+        }
+    }
+    for (mask >>= 1; ret && (mask > 0); mask >>= 1) {
+        if ((vtask + mask) < numTasks_) {
+            ret = p2pSend(buf, bytes, (vtask + mask + root) % numTasks_);
+        }
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::bcastScatterAllgather(char* buf, const int bytes,
+    const int root, const bool ring)
+{
+    // Blocks are laid out by task relative to root, so every binomial
+    // subtree [vtask, vtask + mask) owns one contiguous byte range.
+    auto first = [bytes, this](const int vt)->int {
+        return int((int64_t(bytes) * std::min(vt, numTasks_)) / numTasks_);
+    };
+    auto taskOf = [root, this](const int vt)->int {
+        return (vt + root) % numTasks_; };
+
+    if (!ring && (0 != (numTasks_ & (numTasks_ - 1)))) {
+        // recursive doubling allgather needs a power of two
+        return bcastBinomial(buf, bytes, root);
+    }
+
+    // binomial scatter
+    const int vtask = (taskId_ - root + numTasks_) % numTasks_;
+    bool ret = true;
+    int mask = 1;
+    for (; mask < numTasks_; mask <<= 1) {
+        if (0 != (vtask & mask)) {
+            const int size = first(vtask + mask) - first(vtask);
+            ret = p2pRecv(buf + first(vtask), size, taskOf(vtask - mask));
+            break;
+        }
+    }
+    for (mask >>= 1; ret && (mask > 0); mask >>= 1) {
+        if ((vtask + mask) < numTasks_) {
+            const int size = first(vtask + (2 * mask)) - first(vtask + mask);
+            ret = p2pSend(buf + first(vtask + mask), size,
+                taskOf(vtask + mask));
+        }
+    }
+
+    if (!ret) {
+        // fall through
+    }
+    else if (ring) {
+        const int right = taskOf(vtask + 1);
+        const int left = taskOf(vtask - 1 + numTasks_);
+        for (int step = 0; ret && (step < (numTasks_ - 1)); ++step) {
+            const int sendVt = (vtask - step + numTasks_) % numTasks_;
+            const int recvVt = (vtask - step - 1 + numTasks_) % numTasks_;
+            ret = p2pSendrecv(buf + first(sendVt),
+                first(sendVt + 1) - first(sendVt), right,
+                buf + first(recvVt), first(recvVt + 1) - first(recvVt),
+                left);
+        }
+    }
+    else {
+        // each round swaps the mask-sized aligned group we hold
+        for (mask = 1; ret && (mask < numTasks_); mask <<= 1) {
+            const int peer = taskOf(vtask ^ mask);
+            const int mine = vtask & ~(mask - 1);
+            const int theirs = (vtask ^ mask) & ~(mask - 1);
+            ret = p2pSendrecv(buf + first(mine),
+                first(mine + mask) - first(mine), peer,
+                buf + first(theirs), first(theirs + mask) - first(theirs),
+                peer);
+        }
+    }
+    return ret;
+}
+
+
+bool
+MpiProcess::p2pSend(const void* buf, const int bytes, const int dest)
+{
+    MPI_Request req;
+    return MPIOK(MPI_Isend(buf, bytes, MPI_BYTE, dest, TagColl, comm_,
+        &req)) && mpiWaitAll(1, &req);
+}
+
+
+bool
+MpiProcess::p2pRecv(void* buf, const int bytes, const int src)
+{
+    MPI_Request req;
+    return MPIOK(MPI_Irecv(buf, bytes, MPI_BYTE, src, TagColl, comm_,
+        &req)) && mpiWaitAll(1, &req);
+}
+
+
+bool
+MpiProcess::p2pSendrecv(const void* sendbuf, const int sendBytes,
+    const int dest, void* recvbuf, const int recvBytes, const int src)
+{
+    MPI_Request reqs[2];
+    bool ret = MPIOK(MPI_Irecv(recvbuf, recvBytes, MPI_BYTE, src, TagColl,
+        comm_, &reqs[0]));
+    if (!ret) {
+        // nothing posted
+    }
+    else if (!MPIOK(MPI_Isend(sendbuf, sendBytes, MPI_BYTE, dest, TagColl,
+            comm_, &reqs[1]))) {
+        // don't leave the receive dangling
+        MPI_Cancel(&reqs[0]);
+        MPI_Request_free(&reqs[0]);
+        ret = false;
+    }
+    else {
+        ret = mpiWaitAll(2, reqs);
+    }
+    return ret;
+}
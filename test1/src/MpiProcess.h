@@ -1,6 +1,8 @@
 #ifndef MPIPROCESS_H
 #define MPIPROCESS_H
 
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -8,6 +10,9 @@
 
 #include "mpi.h"
 
+#include "LogGPModel.h"
+#include "ResourceLimits.h"
+
 
 //****************************************************************************
 //****************************************************************************
@@ -25,12 +30,73 @@ public:
         ErrFinalize,
         ErrBarrier,
         ErrBcast,
-        ErrArgs
+        ErrArgs,
+        ErrPredict,
+        ErrCommDup,
+        ErrTune,
+        ErrVegas,
+        ErrDartsFile,
+        ErrLimits
+    };
+
+    // Collective algorithm used by mpiReduce() and mpiBcast(). The hand
+    // implemented ones are built on point-to-point calls. Derived datatypes
+    // and non-commutative ops always use CollLibrary.
+    enum CollAlgo {
+        CollDefault = -1,       // use collAlgo()
+        CollLibrary,            // whatever the MPI library picks
+        CollBinomial,           // log2(P) tree rounds
+        CollRecursiveDoubling,  // butterfly exchange of the full buffer
+        CollRing,               // reduce-scatter/scatter + ring gather
+        CollAuto,               // best measured by mpiTuneCollectives()
+        NumCollAlgos
+    };
+
+    // How a task waits for mpiBarrier(), mpiReduce(), mpiBcast() and the
+    // point-to-point steps of the hand implemented collectives. All tasks
+    // must use the same strategy - blocking and non-blocking collectives
+    // never match each other.
+    enum WaitStrategy {
+        WaitDefault = -1,   // WaitBackoff if any node has more tasks than
+                            // usable CPUs, else WaitBlock
+        WaitBlock,      // blocking calls - the library busy-polls
+        WaitBackoff,    // non-blocking call polled by MPI_Test(). Spins,
+                        // then yields, then sleeps with exponential backoff
+                        // so oversubscribed tasks give their cores away.
+        NumWaitStrategies
+    };
+
+    // Crossover table entry. Payloads up to maxBytes_ use algo_.
+    struct CollTableEntry {
+        int         maxBytes_;
+        CollAlgo    algo_;
+    };
+
+    // mpiVegas() controls. Every iteration samples numEvals_ points in
+    // total across all tasks. The first numAdaptIters_ iterations only shape
+    // the grid and are left out of the result.
+    struct VegasSettings {
+        int         numDims_{ 2 };
+        int         numBins_{ 50 };
+        int         numAdaptIters_{ 5 };
+        int         numIters_{ 10 };
+        uint64_t    numEvals_{ 100000 };
+        double      alpha_{ 1.5 };
+    };
+
+    struct VegasResult {
+        double      integral_{ 0.0 };
+        double      stdErr_{ 0.0 };
+        double      chi2PerDof_{ 0.0 }; // ~1 when the iterations agree
+        int         numIters_{ 0 };     // iterations in the result
     };
 
     static const int    RootUseManager{ -1 };
 
     using StringArray1 = std::vector<std::string>;
+    using CollTable = std::vector<CollTableEntry>;
+    // integrand over the unit hypercube
+    using Integrand = std::function<double(const double *x)>;
 
 public:
     MpiProcess(const MPI_Comm Comm = MPI_COMM_WORLD,
@@ -40,18 +106,67 @@ public:
     ~MpiProcess();
 
 
+    // Standalone entry point. Owns MPI_Init() and MPI_Finalize().
     int             run(const int argc, char *argv[]);
 
+    // Library entry point for hosts that already own MPI. Requires MPI to be
+    // initialized and not finalized. Runs on a private duplicate of the
+    // communicator passed to the ctor and never calls MPI_Init() or
+    // MPI_Finalize(). Must be called by all tasks of that communicator.
+    int             runEmbedded(const StringArray1 &args);
+
 
 protected:
 
     bool            mpiReduce(const void* sendbuf, void* recvbuf,
                         const int count, const MPI_Datatype datatype,
-                        const MPI_Op op, const int root = RootUseManager);
+                        const MPI_Op op, const int root = RootUseManager,
+                        const CollAlgo algo = CollDefault);
 
     bool            mpiBcast(void* buf, const int count,
                         const MPI_Datatype datatype = MPI_UNSIGNED_CHAR,
-                        const int root = RootUseManager);
+                        const int root = RootUseManager,
+                        const CollAlgo algo = CollDefault);
+
+    // Times every algorithm at power-of-8 payloads up to maxBytes and fills
+    // the CollAuto crossover tables. Collective. All tasks end up with the
+    // same tables.
+    bool            mpiTuneCollectives(const int maxBytes = 1 << 20,
+                        const int numIters = 20);
+
+    // Reduces count * numTasks() elements and leaves block t of the result
+    // on task t. Always uses the library algorithm.
+    bool            mpiReduceScatterBlock(const void* sendbuf, void* recvbuf,
+                        const int count, const MPI_Datatype datatype,
+                        const MPI_Op op);
+
+    bool            mpiBarrier();
+
+    // Largest buffer a task should allocate for one piece of work. A
+    // quarter of the tightest per-task memory share on any node, or 0 if
+    // memory is not limited. Same on all tasks.
+    uint64_t        taskBufferBytes() const {
+                        return taskMemoryBytes_ / 4; }
+
+    // Completes count requests using waitStrategy().
+    bool            mpiWaitAll(const int count, MPI_Request *reqs);
+
+    // Adaptive importance sampling of f over [0,1)^numDims_. Collective.
+    // Every task returns the same result.
+    bool            mpiVegas(const Integrand &f, const VegasSettings &vs,
+                        VegasResult &result);
+
+    // Ping-pongs between the manager and a task on another node, or its
+    // neighbor on single node runs. interNode tells which. Collective. Only
+    // the manager's params are meaningful.
+    bool            mpiMeasureLogGP(LogGPModel::Params &params,
+                        bool &interNode, const int numIters = 1000);
+
+    // How much later than a WaitBlock task the LogGP partner answers a
+    // message after idling in a strategy wait long enough to back off.
+    // Collective. Only the manager's wakeSecs is meaningful.
+    bool            mpiMeasureWakeSecs(const WaitStrategy strategy,
+                        double &wakeSecs, const int numIters = 10);
 
     std::string &   getTaskName() const;
 
@@ -69,10 +184,59 @@ protected:
     MPI_Comm        comm() const {
                         return comm_; }
 
+    bool            embedded() const {
+                        return embedded_; }
+
+    CollAlgo        collAlgo() const {
+                        return collAlgo_; }
+
+    void            setCollAlgo(const CollAlgo algo) {
+                        collAlgo_ = ((CollDefault == algo) ? CollLibrary :
+                            algo); }
+
+    const CollTable & reduceTable() const {
+                        return reduceTable_; }
+
+    const CollTable & bcastTable() const {
+                        return bcastTable_; }
+
+    const ResourceLimits & resourceLimits() const {
+                        return resourceLimits_; }
+
+    // Tasks sharing this task's node.
+    int             numNodeTasks() const {
+                        return numNodeTasks_; }
+
+    // True if any node runs more tasks than it has usable CPUs.
+    bool            oversubscribed() const {
+                        return oversubscribed_; }
+
+    WaitStrategy    waitStrategy() const {
+                        return waitStrategy_; }
+
+    void            setWaitStrategy(const WaitStrategy strategy) {
+                        waitStrategy_ = ((WaitDefault != strategy) ?
+                            strategy : (oversubscribed_ ? WaitBackoff :
+                                WaitBlock)); }
+
+    static const char * toString(const CollAlgo algo);
+
+    static CollAlgo toCollAlgo(const std::string &str);
+
+    static const char * toString(const WaitStrategy strategy);
+
+    static WaitStrategy toWaitStrategy(const std::string &str);
+
     bool            MPIOK(const int rc) const {
                         return MPI_SUCCESS == (rc); }
 
 private:
+    int             runTasks(const StringArray1 &args);
+
+    // Reads this task's resource limits and agrees on the node-wide view.
+    // Collective.
+    bool            mpiDetectLimits();
+
     int             runAsManager(const StringArray1 &args);
 
     int             runAsWorker(const StringArray1 &args);
@@ -81,16 +245,69 @@ private:
 
     virtual int     runAsWorkerImpl(const StringArray1 &args) = 0;
 
+    CollAlgo        resolveCollAlgo(const CollAlgo algo, const int bytes,
+                        const CollTable &table) const;
+
+    // True for predefined datatypes such as MPI_DOUBLE
+    bool            isNamedType(const MPI_Datatype datatype) const;
+
+    bool            reduceBinomial(const void* sendbuf, void* recvbuf,
+                        const int count, const MPI_Datatype datatype,
+                        const MPI_Op op, const int root);
+
+    bool            reduceRecursiveDoubling(const void* sendbuf,
+                        void* recvbuf, const int count,
+                        const MPI_Datatype datatype, const MPI_Op op,
+                        const int root);
+
+    bool            reduceRing(const void* sendbuf, void* recvbuf,
+                        const int count, const MPI_Datatype datatype,
+                        const MPI_Op op, const int root);
+
+    bool            bcastBinomial(char* buf, const int bytes, const int root);
+
+    bool            bcastScatterAllgather(char* buf, const int bytes,
+                        const int root, const bool ring);
+
+    // Partner of the manager for point-to-point measurements. Collective.
+    bool            mpiMeasurePartner(int &partner, bool &interNode);
+
+    bool            p2pSend(const void* buf, const int bytes,
+                        const int dest);
+
+    bool            p2pRecv(void* buf, const int bytes, const int src);
+
+    bool            p2pSendrecv(const void* sendbuf, const int sendBytes,
+                        const int dest, void* recvbuf, const int recvBytes,
+                        const int src);
+
 
 private:
+    static const int    TagLogGP{ 1 };
+    static const int    LogGPLongBytes{ 1 << 20 };
+    static const int    TagColl{ 2 };
+    static const int    WaitSpinTests{ 1000 };  // MPI_Test() before yielding
+    static const int    WaitYieldTests{ 100 };  // yields before sleeping
+    static const int    WaitMaxSleepUsecs{ 1000 };
+    static const int    WaitIdleUsecs{ 10000 }; // reaches the max sleep
+
     bool                syncStarts_{ true };
     bool                syncEnds_{ false };
+    bool                embedded_{ false };
     mutable std::string libVerStr_;
     MPI_Comm            comm_;
     int                 numTasks_{ 0 }; // # tasks including managerTaskId_
     int                 taskId_{ -1 };
     mutable std::string taskName_;
     int                 managerTaskId_{ -1 };
+    CollAlgo            collAlgo_{ CollLibrary };
+    WaitStrategy        waitStrategy_{ WaitBlock };
+    CollTable           reduceTable_;
+    CollTable           bcastTable_;
+    ResourceLimits      resourceLimits_;
+    int                 numNodeTasks_{ 1 };
+    bool                oversubscribed_{ false };
+    uint64_t            taskMemoryBytes_{ 0 }; // 0 is unlimited
 };
 
 #endif // MPIPROCESS_H
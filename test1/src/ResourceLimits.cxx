@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#   include <sched.h>
+#endif
+
+#include "ResourceLimits.h"
+
+
+#ifdef __linux__
+
+// Keeps the tightest of the positive values seen so far.
+template<typename T>
+static void
+tighten(T &limit, const T value)
+{
+    if ((value > 0) && ((0 == limit) || (value < limit))) {
+        limit = value;
+    }
+}
+
+
+static bool
+readLine(const std::string &path, std::string &line)
+{
+    std::ifstream f(path);
+    return bool(std::getline(f, line));
+}
+
+
+// Counts the CPUs in a cpuset list such as "0-3,8,10-11".
+static int
+countCpuList(const std::string &list)
+{
+    int ret = 0;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        int lo = -1;
+        int hi = -1;
+        const char dash = '-';
+        std::stringstream rs(range);
+        if (!(rs >> lo)) {
+            continue;
+        }
+        hi = lo;
+        if ((rs.peek() == dash) && rs.ignore() && !(rs >> hi)) {
+            hi = lo;
+        }
+        ret += std::max(hi - lo + 1, 0);
+    }
+    return ret;
+}
+
+
+// Calls visit() for root + path and every ancestor up to root. Limits set
+// on an ancestor cgroup apply to us too.
+static void
+walkCgroup(const std::string &root, const std::string &path,
+    const std::function<void(const std::string &dir)> &visit)
+{
+    std::string p = path;
+    while (!p.empty() && ('/' == p.back())) {
+        p.pop_back();
+    }
+    for (;;) {
+        visit(root + p + "/");
+        if (p.empty()) {
+            break;
+        }
+        p.erase(p.rfind('/'));
+    }
+}
+
+#endif // __linux__
+
+
+ResourceLimits::ResourceLimits() :
+    affinity_(CpuMaskWords, 0)
+{
+}
+
+
+ResourceLimits::~ResourceLimits()
+{
+}
+
+
+void
+ResourceLimits::detect()
+{
+    *this = ResourceLimits();
+    hardwareCpus_ = int(std::thread::hardware_concurrency());
+
+#ifdef __linux__
+    // Our cgroup per controller. The v2 entry has no controller list and is
+    // stored under "".
+    std::map<std::string, std::string> cgroups;
+    std::ifstream procCgroup("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(procCgroup, line)) {
+        const std::size_t c1 = line.find(':');
+        const std::size_t c2 = line.find(':', c1 + 1);
+        if ((std::string::npos == c1) || (std::string::npos == c2)) {
+            continue;
+        }
+        const std::string path{ line.substr(c2 + 1) };
+        std::stringstream controllers(line.substr(c1 + 1, c2 - c1 - 1));
+        std::string controller;
+        if (c2 == (c1 + 1)) {
+            cgroups[""] = path;
+        }
+        while (std::getline(controllers, controller, ',')) {
+            cgroups[controller] = path;
+        }
+    }
+
+    std::string value;
+    if (cgroups.count("")) {
+        // v2 - everything in one hierarchy
+        walkCgroup("/sys/fs/cgroup", cgroups[""],
+            [&](const std::string &dir) {
+                std::stringstream ss;
+                std::string quota;
+                double period = 0.0;
+                if (readLine(dir + "cpu.max", value)) {
+                    ss.str(value);
+                    if ((ss >> quota >> period) && ("max" != quota) &&
+                            (period > 0.0)) {
+                        tighten(cpuQuota_, std::stod(quota) / period);
+                    }
+                }
+                if (readLine(dir + "memory.max", value) && ("max" != value)) {
+                    tighten(memoryBytes_, uint64_t(std::stoull(value)));
+                }
+                if (readLine(dir + "cpuset.cpus.effective", value)) {
+                    tighten(cpusetCpus_, countCpuList(value));
+                }
+            });
+    }
+    if (cgroups.count("cpu")) {
+        // v1 - cpu is often co-mounted with cpuacct
+        for (const char *root : { "/sys/fs/cgroup/cpu,cpuacct",
+                "/sys/fs/cgroup/cpu" }) {
+            walkCgroup(root, cgroups["cpu"], [&](const std::string &dir) {
+                std::string period;
+                if (readLine(dir + "cpu.cfs_quota_us", value) &&
+                        readLine(dir + "cpu.cfs_period_us", period) &&
+                        (std::stod(value) > 0.0) && (std::stod(period) > 0.0)) {
+                    tighten(cpuQuota_, std::stod(value) / std::stod(period));
+                }
+            });
+        }
+    }
+    if (cgroups.count("memory")) {
+        walkCgroup("/sys/fs/cgroup/memory", cgroups["memory"],
+            [&](const std::string &dir) {
+                // "unlimited" reads back as a huge page-aligned number
+                if (readLine(dir + "memory.limit_in_bytes", value) &&
+                        (std::stoull(value) < (uint64_t(1) << 62))) {
+                    tighten(memoryBytes_, uint64_t(std::stoull(value)));
+                }
+            });
+    }
+    if (cgroups.count("cpuset")) {
+        walkCgroup("/sys/fs/cgroup/cpuset", cgroups["cpuset"],
+            [&](const std::string &dir) {
+                if (readLine(dir + "cpuset.cpus", value)) {
+                    tighten(cpusetCpus_, countCpuList(value));
+                }
+            });
+    }
+
+    // Only CPUs in the mask count. The node-wide union is applied by
+    // setNodeAffinity().
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    if (0 == sched_getaffinity(0, sizeof(mask), &mask)) {
+        const int maxCpus = std::min(CpuMaskWords * 64, int(CPU_SETSIZE));
+        for (int cpu = 0; cpu < maxCpus; ++cpu) {
+            if (CPU_ISSET(cpu, &mask)) {
+                affinity_[cpu / 64] |= (uint64_t(1) << (cpu % 64));
+            }
+        }
+    }
+#endif
+}
+
+
+void
+ResourceLimits::setNodeAffinity(const CpuMask &mask)
+{
+    affinityCpus_ = 0;
+    for (const uint64_t word : mask) {
+        affinityCpus_ += int(std::bitset<64>(word).count());
+    }
+}
+
+
+int
+ResourceLimits::effectiveCpus() const
+{
+    int ret = std::max(hardwareCpus_, 1);
+    if (cpusetCpus_ > 0) {
+        ret = std::min(ret, cpusetCpus_);
+    }
+    if (affinityCpus_ > 0) {
+        ret = std::min(ret, affinityCpus_);
+    }
+    if (cpuQuota_ > 0.0) {
+        // a partial CPU still needs a whole thread to use it
+        ret = std::min(ret, std::max(int(std::ceil(cpuQuota_)), 1));
+    }
+    return ret;
+}
+
+
+std::string
+ResourceLimits::toString() const
+{
+    std::stringstream ss;
+    ss << effectiveCpus() << " cpus (quota ";
+    if (cpuQuota_ > 0.0) {
+        ss << cpuQuota_;
+    }
+    else {
+        ss << "none";
+    }
+    ss << ", cpuset " << cpusetCpus_ << ", affinity " << affinityCpus_ <<
+        ", hardware " << hardwareCpus_ <<
+        "), memory ";
+    if (memoryBytes_ > 0) {
+        ss << (memoryBytes_ >> 20) << " MiB";
+    }
+    else {
+        ss << "unlimited";
+    }
+    return ss.str();
+}
@@ -0,0 +1,70 @@
+#ifndef RESOURCELIMITS_H
+#define RESOURCELIMITS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+//****************************************************************************
+//****************************************************************************
+//****************************************************************************
+
+// CPU and memory actually available to this process. Inside a container,
+// std::thread::hardware_concurrency() reports the host's cores. The cgroup
+// (v1 or v2) CPU quota, cpuset and memory limit tell the real story. The
+// cgroup files are only read on Linux.
+class ResourceLimits {
+public:
+    // One bit per CPU, CpuMaskWords words long on every platform
+    using CpuMask = std::vector<uint64_t>;
+
+    static const int    CpuMaskWords{ 16 };
+
+public:
+    ResourceLimits();
+
+    ~ResourceLimits();
+
+
+    // Reads the limits of the calling process. Anything that cannot be
+    // found is left unlimited.
+    void            detect();
+
+    // Processes are usually bound to a core or socket, so one affinity
+    // mask says little about the node. Pass the union of the masks of all
+    // processes sharing the node. An all zero mask is ignored.
+    void            setNodeAffinity(const CpuMask &mask);
+
+    // Whole CPUs this process's node can keep busy without being
+    // throttled. Always at least 1.
+    int             effectiveCpus() const;
+
+    std::string     toString() const;
+
+    double          cpuQuota() const {
+                        return cpuQuota_; }
+
+    int             cpusetCpus() const {
+                        return cpusetCpus_; }
+
+    int             hardwareCpus() const {
+                        return hardwareCpus_; }
+
+    // This process's affinity mask. All zero if unknown.
+    const CpuMask & affinity() const {
+                        return affinity_; }
+
+    uint64_t        memoryBytes() const {
+                        return memoryBytes_; }
+
+private:
+    double          cpuQuota_{ 0.0 };   // CFS quota / period, 0 is none
+    int             cpusetCpus_{ 0 };   // cgroup cpuset, 0 is unknown
+    int             affinityCpus_{ 0 }; // node affinity, 0 is unknown
+    int             hardwareCpus_{ 0 }; // 0 is unknown
+    uint64_t        memoryBytes_{ 0 };  // 0 is none
+    CpuMask         affinity_;
+};
+
+#endif // RESOURCELIMITS_H
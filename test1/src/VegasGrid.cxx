@@ -0,0 +1,99 @@
+#include <cmath>
+
+#include "VegasGrid.h"
+
+
+VegasGrid::VegasGrid(const int numDims, const int numBins) :
+    numDims_(numDims),
+    numBins_(numBins),
+    edges_(numDims * (numBins + 1))
+{
+    // start out uniform
+    for (int d = 0; d < numDims_; ++d) {
+        for (int b = 0; b <= numBins_; ++b) {
+            edges_[(d * (numBins_ + 1)) + b] = double(b) / numBins_;
+        }
+    }
+}
+
+
+VegasGrid::~VegasGrid()
+{
+}
+
+
+double
+VegasGrid::map(const double *u, double *x, int *bins) const
+{
+    double jacobian = 1.0;
+    for (int d = 0; d < numDims_; ++d) {
+        const double pos{ u[d] * numBins_ };
+        const int b = ((int(pos) < numBins_) ? int(pos) : (numBins_ - 1));
+        const double width{ edge(d, b + 1) - edge(d, b) };
+        x[d] = edge(d, b) + ((pos - b) * width);
+        bins[d] = b;
+        jacobian *= numBins_ * width;
+    }
+    return jacobian;
+}
+
+
+void
+VegasGrid::refine(const double *binSums, const double alpha)
+{
+    std::vector<double> smoothed(numBins_);
+    std::vector<double> weights(numBins_);
+    std::vector<double> newEdges(numBins_ + 1);
+    for (int d = 0; d < numDims_; ++d) {
+        const double *sums = binSums + (d * numBins_);
+
+        // average each bin with its neighbors to damp statistical noise
+        double total = 0.0;
+        for (int b = 0; b < numBins_; ++b) {
+            const int lo = ((b > 0) ? (b - 1) : b);
+            const int hi = ((b < (numBins_ - 1)) ? (b + 1) : b);
+            smoothed[b] = (sums[lo] + sums[b] + sums[hi]) /
+                ((hi - lo) + 1);
+            total += smoothed[b];
+        }
+        if (total <= 0.0) {
+            continue; // nothing learned in this dimension
+        }
+
+        // compress the dynamic range: ((r - 1) / ln(r))^alpha
+        double sumWeights = 0.0;
+        for (int b = 0; b < numBins_; ++b) {
+            const double r{ smoothed[b] / total };
+            weights[b] = 0.0;
+            if (r >= 1.0) {
+                weights[b] = 1.0;
+            }
+            else if (r > 0.0) {
+                weights[b] = std::pow((r - 1.0) / std::log(r), alpha);
+            }
+            sumWeights += weights[b];
+        }
+
+        // Move the edges so every new bin holds an equal share of the
+        // weight, interpolating linearly inside the old bins.
+        const double share{ sumWeights / numBins_ };
+        double acc = 0.0;
+        int old = 0;
+        newEdges[0] = 0.0;
+        for (int b = 1; b < numBins_; ++b) {
+            while ((acc < share) && (old < numBins_)) {
+                acc += weights[old++];
+            }
+            acc -= share;
+            const double width{ edge(d, old) - edge(d, old - 1) };
+            newEdges[b] = edge(d, old) -
+                ((weights[old - 1] > 0.0) ?
+                    ((acc / weights[old - 1]) * width) : 0.0);
+        }
+        newEdges[numBins_] = 1.0;
+
+        for (int b = 0; b <= numBins_; ++b) {
+            edges_[(d * (numBins_ + 1)) + b] = newEdges[b];
+        }
+    }
+}
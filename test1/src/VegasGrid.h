@@ -0,0 +1,46 @@
+#ifndef VEGASGRID_H
+#define VEGASGRID_H
+
+#include <vector>
+
+
+//****************************************************************************
+//****************************************************************************
+//****************************************************************************
+
+// Separable VEGAS importance sampling grid over the unit hypercube. Every
+// dimension is split into numBins bins of equal probability but varying
+// width. Narrow bins are where the integrand is large.
+class VegasGrid {
+public:
+    VegasGrid(const int numDims, const int numBins);
+
+    ~VegasGrid();
+
+
+    // Maps uniform u in [0,1)^numDims to x in [0,1)^numDims. Fills the bin
+    // index of x in each dimension and returns the jacobian of the mapping.
+    double          map(const double *u, double *x, int *bins) const;
+
+    // Rebuilds the bin edges from numDims * numBins summed (f * jacobian)^2
+    // contributions, as laid out by map()'s bins. alpha damps the change -
+    // 0 keeps the grid, 1.5 is the usual choice.
+    void            refine(const double *binSums, const double alpha);
+
+    int             numDims() const {
+                        return numDims_; }
+
+    int             numBins() const {
+                        return numBins_; }
+
+private:
+    double          edge(const int dim, const int bin) const {
+                        return edges_[(dim * (numBins_ + 1)) + bin]; }
+
+private:
+    int                 numDims_{ 0 };
+    int                 numBins_{ 0 };
+    std::vector<double> edges_; // numDims_ rows of numBins_ + 1 edges
+};
+
+#endif // VEGASGRID_H